@@ -0,0 +1,214 @@
+#include "benchmark.hpp"
+#include "glyph.hpp"
+#include "image.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+const int repetitions = 3;
+const size_t flaggedShown = 10;
+
+U64 elapsed(Clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+        (Clock::now() - start).count();
+}
+
+bool monoPixel(const FT_Bitmap& bitmap, int x, int y)
+{
+    if (x < 0 || y < 0 || x >= (int)bitmap.width || y >= (int)bitmap.rows)
+    {
+        return false;
+    }
+    const unsigned char* row = bitmap.buffer + y * bitmap.pitch;
+    return (row[x >> 3] >> (7 - (x & 7))) & 1;
+}
+
+// Counts the pixels of 'image', as render() made it from 'glyph', that differ
+// from the FreeType pixel under their centre. 'metrics' are the unscaled ones
+// the glyph was built from.
+size_t countDiffering(const Glyph& glyph, const Image& image,
+                      const FT_Glyph_Metrics& metrics, double scale,
+                      const FT_GlyphSlot slot)
+{
+    const auto& gi = glyph.info();
+    // From the glyph's translated coordinates to pen-relative font units.
+    double shiftX = double(gi.hCursorX - metrics.horiBearingX);
+    double shiftY = double(gi.hCursorY - metrics.horiBearingY);
+    size_t differing = 0;
+    for (size_t y = 0; y < image.height; ++y)
+    {
+        double glyphY = gi.hCursorY - (y + .5) * gi.height / image.height;
+        int ftY = (int)std::floor(slot->bitmap_top - (glyphY - shiftY) * scale);
+        for (size_t x = 0; x < image.width; ++x)
+        {
+            double glyphX = gi.hCursorX + (x + .5) * gi.width / image.width;
+            int ftX = (int)std::floor((glyphX - shiftX) * scale
+                                      - slot->bitmap_left);
+            bool ours = image.p[4 * (y * image.width + x)] != 0;
+            differing += ours != monoPixel(slot->bitmap, ftX, ftY);
+        }
+    }
+    return differing;
+}
+
+double percentile(std::vector<double> values, double p)
+{
+    if (values.empty()) return 0.;
+    std::sort(values.begin(), values.end());
+    size_t index = std::min(values.size() - 1,
+                            (size_t)(p / 100. * (values.size() - 1) + .5));
+    return values[index];
+}
+
+void flag(std::ostream& out, const char* what,
+          std::vector<EngineComparison> glyphs,
+          bool (*isFlagged)(const EngineComparison&, double), double limit,
+          double (*key)(const EngineComparison&))
+{
+    glyphs.erase(std::remove_if(glyphs.begin(), glyphs.end(),
+                                [&](const EngineComparison& g)
+                                { return !isFlagged(g, limit); }),
+                 glyphs.end());
+    std::sort(glyphs.begin(), glyphs.end(),
+              [key](const EngineComparison& a, const EngineComparison& b)
+              { return key(a) > key(b); });
+    out << what << " (" << glyphs.size() << "):";
+    for (size_t i = 0; i < std::min(flaggedShown, glyphs.size()); ++i)
+    {
+        const auto& g = glyphs[i];
+        out << " #" << g.glyph << " (" << std::setprecision(2)
+            << g.speedRatio() << "x, " << std::setprecision(1)
+            << 100. * g.differingFraction() << "%)";
+    }
+    if (glyphs.size() > flaggedShown) out << " ...";
+    out << "\n";
+}
+
+} // End anonymous namespace
+
+FaceBenchmark benchmarkFace(FT_Face face, const std::string& name, int size)
+{
+    FaceBenchmark result{name, size ? size : (int)face->units_per_EM, {}, 0};
+    checkFTError(FT_Set_Pixel_Sizes(face, 0, result.size));
+    FontInfo info(face);
+    double scale = result.size / double(face->units_per_EM);
+
+    for (FT_Long idx = 0; idx < face->num_glyphs; ++idx)
+    {
+        EngineComparison cmp{(U32)idx, ~U64(0), ~U64(0), ~U64(0), 0, 0};
+        try
+        {
+            // Loading the outline is left out of both sides' timings.
+            checkFTError(FT_Load_Glyph(face, idx, FT_LOAD_NO_SCALE));
+            FT_Glyph_Metrics metrics = face->glyph->metrics;
+            std::unique_ptr<Glyph> glyph;
+            Image image;
+            for (int rep = 0; rep < repetitions; ++rep)
+            {
+                auto start = Clock::now();
+                glyph.reset(new Glyph(face->glyph->outline, metrics));
+                cmp.oursBuildNs = std::min(cmp.oursBuildNs, elapsed(start));
+                start = Clock::now();
+                image = render(info, *glyph, 0, result.size);
+                cmp.oursRenderNs = std::min(cmp.oursRenderNs, elapsed(start));
+            }
+            for (int rep = 0; rep < repetitions; ++rep)
+            {
+                // Rendering replaces the outline, so each run reloads it.
+                checkFTError(FT_Load_Glyph(face, idx, FT_LOAD_NO_HINTING));
+                auto start = Clock::now();
+                checkFTError(FT_Render_Glyph(face->glyph,
+                                             FT_RENDER_MODE_MONO));
+                cmp.freetypeNs = std::min(cmp.freetypeNs, elapsed(start));
+            }
+            if (face->glyph->bitmap.pixel_mode != FT_PIXEL_MODE_MONO)
+            {
+                throw std::runtime_error("FreeType did not render in mono.");
+            }
+            cmp.pixels = image.width * image.height;
+            cmp.differing = countDiffering(*glyph, image, metrics, scale,
+                                           face->glyph);
+            result.glyphs.push_back(cmp);
+        }
+        catch (const std::runtime_error&)
+        {
+            ++result.failed;
+        }
+    }
+    return result;
+}
+
+void reportBenchmark(std::ostream& out, const FaceBenchmark& benchmark,
+                     double slowRatio, double diffFraction)
+{
+    const auto& glyphs = benchmark.glyphs;
+    U64 oursBuild = 0, oursRender = 0, freetype = 0;
+    size_t pixels = 0, differing = 0;
+    std::vector<double> ratios, renderRatios, fractions;
+    for (const auto& g : glyphs)
+    {
+        oursBuild += g.oursBuildNs;
+        oursRender += g.oursRenderNs;
+        freetype += g.freetypeNs;
+        pixels += g.pixels;
+        differing += g.differing;
+        ratios.push_back(g.speedRatio());
+        renderRatios.push_back(g.renderRatio());
+        fractions.push_back(g.differingFraction());
+    }
+    U64 ours = oursBuild + oursRender;
+    auto rate = [&](U64 ns) { return ns ? glyphs.size() / (ns / 1e9) : 0.; };
+    size_t slower = std::count_if(ratios.begin(), ratios.end(),
+                                  [](double r) { return r > 1.; });
+
+    auto flags = out.flags();
+    auto precision = out.precision();
+    out << std::fixed << std::setprecision(1)
+        << "Benchmark of '" << benchmark.name << "' at " << benchmark.size
+        << "px: " << glyphs.size() << " glyphs";
+    if (benchmark.failed) out << ", " << benchmark.failed << " failed";
+    out << ".\n"
+        << "  ours:     " << std::setw(10) << ours / 1e6 << " ms, "
+        << std::setw(10) << rate(ours) << " glyphs/s (building "
+        << oursBuild / 1e6 << " ms, render() " << oursRender / 1e6
+        << " ms, " << rate(oursRender) << " glyphs/s)\n"
+        << "  freetype: " << std::setw(10) << freetype / 1e6 << " ms, "
+        << std::setw(10) << rate(freetype) << " glyphs/s\n"
+        << std::setprecision(2)
+        << "  speed ratio (ours/freetype): p50 " << percentile(ratios, 50)
+        << ", p90 " << percentile(ratios, 90) << ", max "
+        << percentile(ratios, 100) << "; slower on " << slower << " glyphs\n"
+        << "  render() alone/freetype: p50 " << percentile(renderRatios, 50)
+        << ", p90 " << percentile(renderRatios, 90) << ", max "
+        << percentile(renderRatios, 100) << "\n"
+        << std::setprecision(3)
+        << "  differing pixels: " << differing << " of " << pixels << " ("
+        << (pixels ? 100. * differing / pixels : 0.) << "%), per glyph p50 "
+        << 100. * percentile(fractions, 50) << "%, p90 "
+        << 100. * percentile(fractions, 90) << "%\n";
+
+    out << std::setprecision(1) << "  ";
+    flag(out, "Slower than FreeType", glyphs,
+         [](const EngineComparison& g, double limit)
+         { return g.speedRatio() > limit; },
+         slowRatio,
+         [](const EngineComparison& g) { return g.speedRatio(); });
+    out << "  ";
+    flag(out, "Differing", glyphs,
+         [](const EngineComparison& g, double limit)
+         { return g.differingFraction() > limit; },
+         diffFraction,
+         [](const EngineComparison& g) { return g.differingFraction(); });
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,59 @@
+#ifndef BENCHMARK_HPP_INCLUDED
+#define BENCHMARK_HPP_INCLUDED
+
+#include "freetype.hpp"
+#include "types.hpp"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Timings and agreement of this engine and FreeType's monochrome rasterizer on
+// one glyph at one size.
+struct EngineComparison
+{
+    U32 glyph;
+    // Best of a few runs each, starting from an outline FreeType has already
+    // loaded, so that both sides time the same work: ours is building the
+    // Glyph and then render(), FreeType's is FT_Render_Glyph in mono mode.
+    U64 oursBuildNs;
+    U64 oursRenderNs;
+    U64 freetypeNs;
+    size_t pixels; // In our image.
+    // Pixels of our image that differ from the FreeType pixel under their
+    // centre. render() stretches the bounding box to whole pixels, so the two
+    // bitmaps are not on quite the same grid.
+    size_t differing;
+
+    double speedRatio() const
+    {
+        return (oursBuildNs + oursRenderNs) / double(freetypeNs);
+    }
+    double renderRatio() const { return oursRenderNs / double(freetypeNs); }
+    double differingFraction() const
+    {
+        return pixels ? differing / double(pixels) : 0.;
+    }
+};
+
+struct FaceBenchmark
+{
+    std::string name;
+    int size; // Pixel height of the em square.
+    std::vector<EngineComparison> glyphs;
+    size_t failed; // Glyphs either engine could not render.
+};
+
+// Renders every glyph of the face with both engines at the given size (zero
+// meaning one pixel per font unit, as for the checksums). Unhinted, so that
+// both rasterize the same outline.
+FaceBenchmark benchmarkFace(FT_Face face, const std::string& name, int size);
+
+// Prints throughput per engine, the distribution of per-glyph speed ratios
+// and pixel differences, and flags the glyphs which are more than slowRatio
+// times slower than FreeType or have more than diffFraction of their pixels
+// differing, worst first.
+void reportBenchmark(std::ostream& out, const FaceBenchmark& benchmark,
+                     double slowRatio = 1., double diffFraction = .05);
+
+#endif // BENCHMARK_HPP_INCLUDED
@@ -0,0 +1,207 @@
+#include "checksums.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+
+namespace
+{
+
+const char shardMagic[4] = {'F', 'C', 'R', 'C'};
+const U32 shardVersion = 2;
+// Face names are file names, so anything longer is a corrupt file.
+const U32 maxFaceLength = 1024;
+
+// Shard files are little-endian regardless of the host.
+void putU32(std::ostream& out, U32 v)
+{
+    char bytes[4] = {char(v), char(v >> 8), char(v >> 16), char(v >> 24)};
+    out.write(bytes, 4);
+}
+
+U32 getU32(std::istream& in)
+{
+    unsigned char bytes[4];
+    if (!in.read(reinterpret_cast<char*>(bytes), 4))
+    {
+        throw std::runtime_error("Truncated checksum shard.");
+    }
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((U32)bytes[3] << 24);
+}
+
+} // End anonymous namespace
+
+Checksums readChecksums(const std::string& filename)
+{
+    Checksums checksums;
+    std::ifstream input(filename.c_str());
+    int glyph;
+    U32 sum;
+    while (input >> glyph >> sum)
+    {
+        checksums[glyph] = sum;
+    }
+    return checksums;
+}
+
+bool writeChecksums(const std::string& filename, const Checksums& checksums)
+{
+    std::ofstream output(filename.c_str());
+    if (!output.is_open()) return false;
+    for (auto& sum : checksums)
+    {
+        output << sum.first << ' ' << sum.second << '\n';
+    }
+    return true;
+}
+
+void writeChecksumShard(const std::string& filename, const ShardHeader& header,
+                        const Checksums& checksums)
+{
+    std::ofstream output(filename.c_str(), std::ios::binary);
+    if (!output.is_open())
+    {
+        throw std::runtime_error("Could not open " + filename
+                                 + " for writing.");
+    }
+    output.write(shardMagic, 4);
+    putU32(output, shardVersion);
+    putU32(output, static_cast<U32>(header.face.size()));
+    output.write(header.face.data(), header.face.size());
+    putU32(output, header.pixelSize);
+    putU32(output, header.shard);
+    putU32(output, header.shardCount);
+    putU32(output, static_cast<U32>(checksums.size()));
+    // std::map iterates in glyph order, which keeps the file sorted.
+    for (auto& sum : checksums)
+    {
+        putU32(output, sum.first);
+        putU32(output, sum.second);
+    }
+    if (!output)
+    {
+        throw std::runtime_error("Could not write " + filename + ".");
+    }
+}
+
+Checksums readChecksumShard(const std::string& filename, ShardHeader& header)
+{
+    std::ifstream input(filename.c_str(), std::ios::binary);
+    if (!input.is_open())
+    {
+        throw std::runtime_error("Could not open " + filename + ".");
+    }
+    char magic[4];
+    if (!input.read(magic, 4) || std::memcmp(magic, shardMagic, 4) != 0
+        || getU32(input) != shardVersion)
+    {
+        throw std::runtime_error(filename + " is not a checksum shard.");
+    }
+    U32 faceLength = getU32(input);
+    if (faceLength > maxFaceLength)
+    {
+        throw std::runtime_error(filename + " is not a checksum shard.");
+    }
+    header.face.resize(faceLength);
+    if (!input.read(&header.face[0], faceLength))
+    {
+        throw std::runtime_error("Truncated checksum shard.");
+    }
+    header.pixelSize = getU32(input);
+    header.shard = getU32(input);
+    header.shardCount = getU32(input);
+    U32 count = getU32(input);
+
+    Checksums checksums;
+    int previous = -1;
+    for (U32 i = 0; i < count; ++i)
+    {
+        int glyph = static_cast<int>(getU32(input));
+        U32 sum = getU32(input);
+        if (glyph <= previous)
+        {
+            throw std::runtime_error(filename + " is not sorted.");
+        }
+        checksums.emplace_hint(checksums.end(), glyph, sum);
+        previous = glyph;
+    }
+    return checksums;
+}
+
+Checksums mergeChecksumShards(const std::vector<std::string>& filenames,
+                              ShardHeader& header)
+{
+    Checksums merged;
+    std::set<U32> shards;
+    header = ShardHeader{std::string(), 0, 0, 0};
+    for (const auto& filename : filenames)
+    {
+        ShardHeader part;
+        Checksums sums = readChecksumShard(filename, part);
+        if (shards.empty())
+        {
+            header.face = part.face;
+            header.pixelSize = part.pixelSize;
+            header.shardCount = part.shardCount;
+        }
+        if (part.face != header.face || part.pixelSize != header.pixelSize
+            || part.shardCount != header.shardCount
+            || part.shard >= part.shardCount
+            || !shards.insert(part.shard).second)
+        {
+            throw std::runtime_error(filename
+                                     + " does not fit the other shards.");
+        }
+        for (auto& sum : sums)
+        {
+            if (U32(sum.first) % part.shardCount != part.shard)
+            {
+                throw std::runtime_error(filename + " holds glyph "
+                                         + std::to_string(sum.first)
+                                         + ", which is not in its shard.");
+            }
+            // Shards hold disjoint glyphs, so nothing is overwritten.
+            merged.insert(merged.end(), sum);
+        }
+    }
+    if (shards.size() != header.shardCount)
+    {
+        throw std::runtime_error("Only " + std::to_string(shards.size())
+                                 + " of " + std::to_string(header.shardCount)
+                                 + " shards given.");
+    }
+    return merged;
+}
+
+std::string shardFilename(const std::string& fontname, U32 shard,
+                          U32 shardCount)
+{
+    return fontname + ".shard-" + std::to_string(shard) + "-of-"
+         + std::to_string(shardCount) + ".crcb";
+}
+
+ChecksumDiff diffChecksums(const Checksums& golden, const Checksums& actual)
+{
+    ChecksumDiff diff;
+    auto g = golden.begin();
+    auto a = actual.begin();
+    while (g != golden.end() || a != actual.end())
+    {
+        if (a == actual.end() || (g != golden.end() && g->first < a->first))
+        {
+            diff.missing.push_back((g++)->first);
+        }
+        else if (g == golden.end() || a->first < g->first)
+        {
+            diff.unexpected.push_back((a++)->first);
+        }
+        else
+        {
+            if (g->second != a->second) diff.mismatched.push_back(g->first);
+            ++g;
+            ++a;
+        }
+    }
+    return diff;
+}
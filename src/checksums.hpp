@@ -0,0 +1,58 @@
+#ifndef CHECKSUMS_HPP_INCLUDED
+#define CHECKSUMS_HPP_INCLUDED
+
+#include "types.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Rendered image checksum per glyph index.
+using Checksums = std::map<int, U32>;
+
+// Golden files are text, one "<glyph> <checksum>" line per glyph.
+Checksums readChecksums(const std::string& filename);
+bool writeChecksums(const std::string& filename, const Checksums& checksums);
+
+// What a shard file holds: the glyphs with index % shardCount == shard of
+// one face, rendered at one pixel size.
+struct ShardHeader
+{
+    std::string face;
+    U32 pixelSize;  // Zero for one pixel per font unit, as in the goldens.
+    U32 shard;
+    U32 shardCount;
+};
+
+// Partial results of one shard in a binary file sorted by glyph index, so
+// that any number of processes can write their own without coordinating.
+void writeChecksumShard(const std::string& filename, const ShardHeader& header,
+                        const Checksums& checksums);
+Checksums readChecksumShard(const std::string& filename, ShardHeader& header);
+
+// Combines shard files into one set and returns their common header in
+// 'header' (with shard left at zero). Throws if the files disagree on the
+// face, pixel size or shard count, repeat or miss a shard, or hold a glyph
+// of another shard.
+Checksums mergeChecksumShards(const std::vector<std::string>& filenames,
+                              ShardHeader& header);
+
+// Name of the partial file written by a shard for the given font.
+std::string shardFilename(const std::string& fontname, U32 shard,
+                          U32 shardCount);
+
+struct ChecksumDiff
+{
+    std::vector<int> mismatched; // In both, with different checksums.
+    std::vector<int> missing;    // Golden only.
+    std::vector<int> unexpected; // Actual only.
+
+    bool empty() const
+    {
+        return mismatched.empty() && missing.empty() && unexpected.empty();
+    }
+};
+
+ChecksumDiff diffChecksums(const Checksums& golden, const Checksums& actual);
+
+#endif // CHECKSUMS_HPP_INCLUDED
@@ -0,0 +1,355 @@
+#include "composite.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COMPOSITE_X86 1
+#include <immintrin.h>
+#else
+#define COMPOSITE_X86 0
+#endif
+
+namespace
+{
+
+// Rounded x/255 for x <= 255*255; equal to (x + 127) / 255.
+inline U32 div255(U32 x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+void compositeMaskScalar(U8* dst, const U8* mask, size_t count, Colour colour)
+{
+    // Treating the colour as opaque in the alpha channel gives
+    // alpha + dst.a*(255-alpha)/255 there.
+    const U32 src[4] = {colour.r, colour.g, colour.b, 255};
+    for (size_t i = 0; i < count; ++i, dst += 4)
+    {
+        U32 alpha = div255(mask[i] * colour.a);
+        for (size_t c = 0; c < 4; ++c)
+        {
+            dst[c] = div255(src[c] * alpha + dst[c] * (255 - alpha));
+        }
+    }
+}
+
+void grayToRgbaScalar(U8* dst, const U8* gray, size_t count)
+{
+    for (size_t i = 0; i < count; ++i, dst += 4)
+    {
+        dst[0] = dst[1] = dst[2] = gray[i];
+        dst[3] = 0xff;
+    }
+}
+
+void blendPremultipliedScalar(U8* dst, const U8* src, size_t count)
+{
+    for (size_t i = 0; i < count; ++i, dst += 4, src += 4)
+    {
+        U32 inverse = 255 - src[3];
+        for (size_t c = 0; c < 4; ++c)
+        {
+            dst[c] = std::min<U32>(255, src[c] + div255(dst[c] * inverse));
+        }
+    }
+}
+
+#if COMPOSITE_X86
+
+// The vector kernels work on 16-bit lanes, which hold every intermediate
+// product exactly (at most 255*255 + 128 + 254).
+
+__attribute__((target("sse2")))
+inline __m128i div255(__m128i x)
+{
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Mask bytes m0..m3 repeated over each pixel's four channels.
+__attribute__((target("sse2")))
+inline __m128i spreadMask(const U8* mask)
+{
+    U32 m;
+    std::memcpy(&m, mask, 4);
+    __m128i v = _mm_cvtsi32_si128(m);
+    v = _mm_unpacklo_epi8(v, v);
+    return _mm_unpacklo_epi16(v, v);
+}
+
+// Blends two pixels (16-bit lanes) with per-lane alpha.
+__attribute__((target("sse2")))
+inline __m128i blend(__m128i src, __m128i dst, __m128i alpha)
+{
+    __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+    return div255(_mm_add_epi16(_mm_mullo_epi16(src, alpha),
+                                _mm_mullo_epi16(dst, inverse)));
+}
+
+__attribute__((target("sse2")))
+void compositeMaskSse2(U8* dst, const U8* mask, size_t count, Colour colour)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i src = _mm_setr_epi16(colour.r, colour.g, colour.b, 255,
+                                       colour.r, colour.g, colour.b, 255);
+    const __m128i coverageScale = _mm_set1_epi16(colour.a);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4, dst += 16)
+    {
+        __m128i m = spreadMask(mask + i);
+        __m128i alphaLo = div255(_mm_mullo_epi16(_mm_unpacklo_epi8(m, zero),
+                                                 coverageScale));
+        __m128i alphaHi = div255(_mm_mullo_epi16(_mm_unpackhi_epi8(m, zero),
+                                                 coverageScale));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+        __m128i lo = blend(src, _mm_unpacklo_epi8(d, zero), alphaLo);
+        __m128i hi = blend(src, _mm_unpackhi_epi8(d, zero), alphaHi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                         _mm_packus_epi16(lo, hi));
+    }
+    compositeMaskScalar(dst, mask + i, count - i, colour);
+}
+
+__attribute__((target("sse2")))
+void grayToRgbaSse2(U8* dst, const U8* gray, size_t count)
+{
+    const __m128i opaque = _mm_set1_epi8((char)0xff);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16, dst += 64)
+    {
+        __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gray + i));
+        __m128i gg[2] = {_mm_unpacklo_epi8(g, g), _mm_unpackhi_epi8(g, g)};
+        __m128i ga[2] = {_mm_unpacklo_epi8(g, opaque),
+                         _mm_unpackhi_epi8(g, opaque)};
+        for (size_t k = 0; k < 2; ++k)
+        {
+            __m128i* out = reinterpret_cast<__m128i*>(dst + 32 * k);
+            _mm_storeu_si128(out, _mm_unpacklo_epi16(gg[k], ga[k]));
+            _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(gg[k], ga[k]));
+        }
+    }
+    grayToRgbaScalar(dst, gray + i, count - i);
+}
+
+__attribute__((target("sse2")))
+void blendPremultipliedSse2(U8* dst, const U8* src, size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(255);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4, dst += 16, src += 16)
+    {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+        __m128i half[2];
+        for (size_t k = 0; k < 2; ++k)
+        {
+            __m128i s16 = k ? _mm_unpackhi_epi8(s, zero) : _mm_unpacklo_epi8(s, zero);
+            __m128i d16 = k ? _mm_unpackhi_epi8(d, zero) : _mm_unpacklo_epi8(d, zero);
+            __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s16, 0xff), 0xff);
+            half[k] = div255(_mm_mullo_epi16(d16, _mm_sub_epi16(full, alpha)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                         _mm_adds_epu8(s, _mm_packus_epi16(half[0], half[1])));
+    }
+    blendPremultipliedScalar(dst, src, count - i);
+}
+
+__attribute__((target("avx2")))
+inline __m256i div255(__m256i x)
+{
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+__attribute__((target("avx2")))
+void compositeMaskAvx2(U8* dst, const U8* mask, size_t count, Colour colour)
+{
+    const __m256i src = _mm256_setr_epi16(colour.r, colour.g, colour.b, 255,
+                                          colour.r, colour.g, colour.b, 255,
+                                          colour.r, colour.g, colour.b, 255,
+                                          colour.r, colour.g, colour.b, 255);
+    const __m256i coverageScale = _mm256_set1_epi16(colour.a);
+    const __m256i full = _mm256_set1_epi16(255);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4, dst += 16)
+    {
+        __m256i alpha = div255(_mm256_mullo_epi16(
+            _mm256_cvtepu8_epi16(spreadMask(mask + i)), coverageScale));
+        __m256i d = _mm256_cvtepu8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst)));
+        __m256i out = div255(_mm256_add_epi16(
+            _mm256_mullo_epi16(src, alpha),
+            _mm256_mullo_epi16(d, _mm256_sub_epi16(full, alpha))));
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(out),
+                                          _mm256_extracti128_si256(out, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), packed);
+    }
+    compositeMaskScalar(dst, mask + i, count - i, colour);
+}
+
+__attribute__((target("avx2")))
+void grayToRgbaAvx2(U8* dst, const U8* gray, size_t count)
+{
+    const __m256i opaque = _mm256_set1_epi8((char)0xff);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32, dst += 128)
+    {
+        __m256i g = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(gray + i));
+        // Unpacking works within 128-bit lanes; reorder the quadwords so that
+        // each unpack sees consecutive pixels.
+        g = _mm256_permute4x64_epi64(g, 0xd8);
+        __m256i gg[2] = {_mm256_unpacklo_epi8(g, g), _mm256_unpackhi_epi8(g, g)};
+        __m256i ga[2] = {_mm256_unpacklo_epi8(g, opaque),
+                         _mm256_unpackhi_epi8(g, opaque)};
+        for (size_t k = 0; k < 2; ++k)
+        {
+            __m256i lo = _mm256_unpacklo_epi16(gg[k], ga[k]);
+            __m256i hi = _mm256_unpackhi_epi16(gg[k], ga[k]);
+            __m256i* out = reinterpret_cast<__m256i*>(dst + 64 * k);
+            _mm256_storeu_si256(out, _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(lo, hi, 0x31));
+        }
+    }
+    grayToRgbaSse2(dst, gray + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void blendPremultipliedAvx2(U8* dst, const U8* src, size_t count)
+{
+    const __m256i full = _mm256_set1_epi16(255);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4, dst += 16, src += 16)
+    {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        __m256i s16 = _mm256_cvtepu8_epi16(s);
+        __m256i d16 = _mm256_cvtepu8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst)));
+        __m256i alpha = _mm256_shufflehi_epi16(
+            _mm256_shufflelo_epi16(s16, 0xff), 0xff);
+        __m256i scaled = div255(_mm256_mullo_epi16(d16,
+                                                   _mm256_sub_epi16(full, alpha)));
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(scaled),
+                                          _mm256_extracti128_si256(scaled, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+                         _mm_adds_epu8(s, packed));
+    }
+    blendPremultipliedScalar(dst, src, count - i);
+}
+
+#endif // COMPOSITE_X86
+
+struct Kernels
+{
+    void (*compositeMask)(U8*, const U8*, size_t, Colour);
+    void (*grayToRgba)(U8*, const U8*, size_t);
+    void (*blendPremultiplied)(U8*, const U8*, size_t);
+    const char* name;
+};
+
+Kernels selectKernels()
+{
+#if COMPOSITE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return {compositeMaskAvx2, grayToRgbaAvx2, blendPremultipliedAvx2,
+                "avx2"};
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return {compositeMaskSse2, grayToRgbaSse2, blendPremultipliedSse2,
+                "sse2"};
+    }
+#endif
+    return {compositeMaskScalar, grayToRgbaScalar, blendPremultipliedScalar,
+            "scalar"};
+}
+
+const Kernels& kernels()
+{
+    static const Kernels selected = selectKernels();
+    return selected;
+}
+
+// Clips a width x height source placed at (x, y) to dst. Gives the first
+// source row and column drawn and how many of each.
+bool clip(const Image& dst, int x, int y, size_t width, size_t height,
+          size_t& srcX, size_t& srcY, size_t& columns, size_t& rows)
+{
+    int x0 = std::max(x, 0);
+    int y0 = std::max(y, 0);
+    int x1 = std::min<int>(x + (int)width, (int)dst.width);
+    int y1 = std::min<int>(y + (int)height, (int)dst.height);
+    if (x0 >= x1 || y0 >= y1) return false;
+    srcX = x0 - x;
+    srcY = y0 - y;
+    columns = x1 - x0;
+    rows = y1 - y0;
+    return true;
+}
+
+} // End anonymous namespace
+
+void compositeMaskRow(U8* dst, const U8* mask, size_t count, Colour colour)
+{
+    kernels().compositeMask(dst, mask, count, colour);
+}
+
+void grayToRgbaRow(U8* dst, const U8* gray, size_t count)
+{
+    kernels().grayToRgba(dst, gray, count);
+}
+
+void blendPremultipliedRow(U8* dst, const U8* src, size_t count)
+{
+    kernels().blendPremultiplied(dst, src, count);
+}
+
+void compositeMask(Image& dst, int x, int y, const U8* mask,
+                   size_t width, size_t height, size_t stride, Colour colour)
+{
+    size_t srcX, srcY, columns, rows;
+    if (!clip(dst, x, y, width, height, srcX, srcY, columns, rows)) return;
+    auto kernel = kernels().compositeMask;
+    for (size_t row = 0; row < rows; ++row)
+    {
+        kernel(dst.row(y + srcY + row) + 4 * (x + srcX),
+               mask + (srcY + row) * stride + srcX, columns, colour);
+    }
+}
+
+void blitGray(Image& dst, int x, int y, const U8* gray,
+              size_t width, size_t height, size_t stride)
+{
+    size_t srcX, srcY, columns, rows;
+    if (!clip(dst, x, y, width, height, srcX, srcY, columns, rows)) return;
+    auto kernel = kernels().grayToRgba;
+    for (size_t row = 0; row < rows; ++row)
+    {
+        kernel(dst.row(y + srcY + row) + 4 * (x + srcX),
+               gray + (srcY + row) * stride + srcX, columns);
+    }
+}
+
+void blendPremultiplied(Image& dst, int x, int y, const Image& src)
+{
+    size_t srcX, srcY, columns, rows;
+    if (!clip(dst, x, y, src.width, src.height, srcX, srcY, columns, rows))
+    {
+        return;
+    }
+    auto kernel = kernels().blendPremultiplied;
+    for (size_t row = 0; row < rows; ++row)
+    {
+        kernel(dst.row(y + srcY + row) + 4 * (x + srcX),
+               src.row(srcY + row) + 4 * srcX, columns);
+    }
+}
+
+const char* compositeKernels()
+{
+    return kernels().name;
+}
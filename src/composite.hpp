@@ -0,0 +1,32 @@
+#ifndef COMPOSITE_HPP_INCLUDED
+#define COMPOSITE_HPP_INCLUDED
+
+#include "image.hpp"
+#include "types.hpp"
+
+// Compositing of 8-bit masks and RGBA pixels (laid out as in Image), with
+// SSE2 and AVX2 kernels chosen at run time on x86 and a scalar fallback
+// elsewhere. All results are rounded exactly as the scalar code rounds, so
+// output does not depend on the kernel used.
+
+// Row kernels, on 'count' pixels.
+// Blends 'colour' over dst with alpha mask*colour.a/255, as
+// RleBitmap::composite() does.
+void compositeMaskRow(U8* dst, const U8* mask, size_t count, Colour colour);
+// Writes each mask value as an opaque gray pixel.
+void grayToRgbaRow(U8* dst, const U8* gray, size_t count);
+// Premultiplied source over destination: dst = src + dst*(255-src.a)/255.
+void blendPremultipliedRow(U8* dst, const U8* src, size_t count);
+
+// Whole-image versions placing the source's top-left corner at (x, y) in dst,
+// clipped to dst. Mask and gray sources have 'stride' bytes per row.
+void compositeMask(Image& dst, int x, int y, const U8* mask,
+                   size_t width, size_t height, size_t stride, Colour colour);
+void blitGray(Image& dst, int x, int y, const U8* gray,
+              size_t width, size_t height, size_t stride);
+void blendPremultiplied(Image& dst, int x, int y, const Image& src);
+
+// Name of the kernel set in use: "avx2", "sse2" or "scalar".
+const char* compositeKernels();
+
+#endif // COMPOSITE_HPP_INCLUDED
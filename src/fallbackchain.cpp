@@ -0,0 +1,57 @@
+#include "fallbackchain.hpp"
+
+#include <stdexcept>
+
+FallbackChain::FallbackChain(const std::vector<FT_Face>& faces)
+    : m_faceCount{faces.size()},
+      m_pageIndex(maxCodepoint >> pageBits, 0),
+      m_pages(1, Page(pageSize, 0))
+{
+    if (faces.size() > maxFaces)
+    {
+        throw std::domain_error("Too many faces in fallback chain.");
+    }
+    for (size_t f = 0; f < faces.size(); ++f)
+    {
+        FT_Face face = faces[f];
+        if (FT_Select_Charmap(face, FT_ENCODING_UNICODE)) continue;
+
+        FT_UInt glyph;
+        FT_ULong codepoint = FT_Get_First_Char(face, &glyph);
+        while (glyph)
+        {
+            if (codepoint < maxCodepoint && glyph <= glyphMask)
+            {
+                U16& page = m_pageIndex[codepoint >> pageBits];
+                if (!page)
+                {
+                    page = m_pages.size();
+                    m_pages.push_back(Page(pageSize, 0));
+                }
+                U32& entry = m_pages[page][codepoint & (pageSize - 1)];
+                // Keep the mapping of an earlier face.
+                if (!entry) entry = (U32)(f + 1) << glyphBits | glyph;
+            }
+            codepoint = FT_Get_Next_Char(face, codepoint, &glyph);
+        }
+    }
+}
+
+size_t FallbackChain::map(const U32* codepoints, size_t count,
+                          U8* faces, U32* glyphs) const
+{
+    size_t found = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t face;
+        found += lookup(codepoints[i], face, glyphs[i]);
+        faces[i] = face;
+    }
+    return found;
+}
+
+size_t FallbackChain::memoryUsage() const
+{
+    return sizeof(*this) + m_pageIndex.capacity() * sizeof(U16)
+         + m_pages.size() * (sizeof(Page) + pageSize * sizeof(U32));
+}
@@ -0,0 +1,61 @@
+#ifndef FALLBACKCHAIN_HPP_INCLUDED
+#define FALLBACKCHAIN_HPP_INCLUDED
+
+#include "freetype.hpp"
+#include "types.hpp"
+
+#include <vector>
+
+// Maps Unicode code points to a glyph in the first of an ordered list of faces
+// that has one. The faces' character maps are read once into a two-level
+// table (256 code point pages), so lookups are a pair of array reads without
+// any FreeType calls.
+class FallbackChain
+{
+public:
+    // Earlier faces take priority. Faces without a Unicode character map
+    // contribute nothing.
+    FallbackChain(const std::vector<FT_Face>& faces);
+
+    size_t faceCount() const { return m_faceCount; }
+
+    // Finds the face and glyph index for a code point. If no face has it, gives
+    // the first face's missing glyph (index 0) and returns false.
+    bool lookup(U32 codepoint, size_t& face, U32& glyph) const
+    {
+        U32 entry = 0;
+        if (codepoint < maxCodepoint)
+        {
+            entry = m_pages[m_pageIndex[codepoint >> pageBits]]
+                           [codepoint & (pageSize - 1)];
+        }
+        face = entry ? (entry >> glyphBits) - 1 : 0;
+        glyph = entry & glyphMask;
+        return entry != 0;
+    }
+
+    // Looks up a whole string; returns the number of code points found.
+    size_t map(const U32* codepoints, size_t count,
+               U8* faces, U32* glyphs) const;
+
+    size_t memoryUsage() const; // In bytes.
+
+    static const size_t maxFaces = 255;
+
+private:
+    static const U32 maxCodepoint = 0x110000;
+    static const U32 pageBits = 8;
+    static const U32 pageSize = 1 << pageBits;
+    // Entries are (face + 1) << glyphBits | glyph, zero meaning unmapped.
+    static const U32 glyphBits = 24;
+    static const U32 glyphMask = (1 << glyphBits) - 1;
+
+    using Page = std::vector<U32>;
+
+    size_t m_faceCount;
+    // Page 0 is all zeroes and shared by every unmapped range.
+    std::vector<U16> m_pageIndex;
+    std::vector<Page> m_pages;
+};
+
+#endif // FALLBACKCHAIN_HPP_INCLUDED
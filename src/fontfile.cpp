@@ -0,0 +1,55 @@
+#include "fontfile.hpp"
+
+#include <map>
+#include <mutex>
+
+namespace
+{
+
+// Guards the registry of open files.
+std::mutex fileMutex;
+std::map<std::string, std::weak_ptr<const FontFile>> openFiles;
+
+// FT_New_Memory_Face and FT_Done_Face modify the library they belong to and
+// must not run concurrently on it.
+std::mutex faceMutex;
+
+} // End anonymous namespace
+
+std::shared_ptr<const FontFile> FontFile::open(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(fileMutex);
+    auto& entry = openFiles[path];
+    std::shared_ptr<const FontFile> file = entry.lock();
+    if (!file)
+    {
+        file.reset(new FontFile(path));
+        entry = file;
+    }
+    // Drop registry entries of files that have since been released.
+    for (auto it = openFiles.begin(); it != openFiles.end();)
+    {
+        if (it->second.expired()) it = openFiles.erase(it);
+        else ++it;
+    }
+    return file;
+}
+
+FontFile::FontFile(const std::string& path)
+    : m_file(path) {}
+
+FontFace::FontFace(std::shared_ptr<const FontFile> file, FT_Library library,
+                   FT_Long faceIndex)
+    : m_file{std::move(file)}, m_face{nullptr}
+{
+    std::lock_guard<std::mutex> lock(faceMutex);
+    checkFTError(FT_New_Memory_Face(library, m_file->data(),
+                                    static_cast<FT_Long>(m_file->size()),
+                                    faceIndex, &m_face));
+}
+
+FontFace::~FontFace()
+{
+    std::lock_guard<std::mutex> lock(faceMutex);
+    FT_Done_Face(m_face);
+}
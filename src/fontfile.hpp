@@ -0,0 +1,57 @@
+#ifndef FONTFILE_HPP_INCLUDED
+#define FONTFILE_HPP_INCLUDED
+
+#include "freetype.hpp"
+#include "mappedfile.hpp"
+#include "types.hpp"
+
+#include <memory>
+#include <string>
+
+// A font file mapped into memory once per process and shared by every face
+// created from it. Opening the same path again while a handle is alive gives
+// back the same mapping; the mapping is released with the last handle (faces
+// hold one too).
+class FontFile
+{
+public:
+    static std::shared_ptr<const FontFile> open(const std::string& path);
+
+    FontFile(const FontFile&) = delete;
+    FontFile& operator=(const FontFile&) = delete;
+
+    const U8* data() const { return m_file.data(); }
+    size_t size() const { return m_file.size(); }
+    const std::string& path() const { return m_file.path(); }
+
+private:
+    FontFile(const std::string& path);
+
+    MappedFile m_file;
+};
+
+// FreeType face reading directly from a shared FontFile, so creating one costs
+// no file I/O and no copy of the font data. A face must only be used by one
+// thread at a time, but faces over the same file (even from the same library)
+// may be used concurrently; creation and destruction are serialised
+// internally as FreeType requires.
+class FontFace
+{
+public:
+    FontFace(std::shared_ptr<const FontFile> file, FT_Library library,
+             FT_Long faceIndex = 0);
+    ~FontFace();
+
+    FontFace(const FontFace&) = delete;
+    FontFace& operator=(const FontFace&) = delete;
+
+    FT_Face face() const { return m_face; }
+    FT_Face operator->() const { return m_face; }
+    const FontFile& file() const { return *m_file; }
+
+private:
+    std::shared_ptr<const FontFile> m_file;
+    FT_Face m_face;
+};
+
+#endif // FONTFILE_HPP_INCLUDED
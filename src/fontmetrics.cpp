@@ -0,0 +1,77 @@
+#include "fontmetrics.hpp"
+#include "truetype.hpp"
+
+#include <stdexcept>
+
+FontMetricsTable::FontMetricsTable(const FontFace& face)
+    : m_font(face.face())
+{
+    TrueTypeFont font(face.file().data(), face.file().size());
+    size_t count = font.glyphCount();
+    m_xAdvance.resize(count);
+    m_yAdvance.resize(count);
+    m_hBearingX.resize(count);
+    m_hBearingY.resize(count);
+    m_vBearingX.resize(count);
+    m_vBearingY.resize(count);
+    m_width.resize(count);
+    m_height.resize(count);
+
+    // One broken glyph should not keep the rest of the face from being laid
+    // out, so it is recorded and left at zero.
+    for (size_t i = 0; i < count; ++i)
+    {
+        Glyph::GlyphInfo metrics;
+        try
+        {
+            font.loadMetrics(static_cast<U32>(i), metrics);
+        }
+        catch (const std::runtime_error&)
+        {
+            m_failed.push_back(static_cast<U32>(i));
+            continue;
+        }
+        m_xAdvance[i] = metrics.xAdvance;
+        m_yAdvance[i] = metrics.yAdvance;
+        m_hBearingX[i] = metrics.hCursorX;
+        m_hBearingY[i] = metrics.hCursorY;
+        m_vBearingX[i] = metrics.vCursorX;
+        m_vBearingY[i] = metrics.vCursorY;
+        m_width[i] = metrics.width;
+        m_height[i] = metrics.height;
+    }
+}
+
+Glyph::GlyphInfo FontMetricsTable::info(U32 glyph) const
+{
+    Glyph::GlyphInfo info;
+    info.width = m_width[glyph];
+    info.height = m_height[glyph];
+    info.hCursorX = m_hBearingX[glyph];
+    info.hCursorY = m_hBearingY[glyph];
+    info.xAdvance = m_xAdvance[glyph];
+    info.vCursorX = m_vBearingX[glyph];
+    info.vCursorY = m_vBearingY[glyph];
+    info.yAdvance = m_yAdvance[glyph];
+    return info;
+}
+
+S64 FontMetricsTable::measure(const U32* glyphs, size_t count) const
+{
+    const S32* advance = m_xAdvance.data();
+    S64 width = 0;
+    for (size_t i = 0; i < count; ++i) width += advance[glyphs[i]];
+    return width;
+}
+
+size_t FontMetricsTable::fit(const U32* glyphs, size_t count, S64 width) const
+{
+    const S32* advance = m_xAdvance.data();
+    S64 used = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        used += advance[glyphs[i]];
+        if (used > width) return i;
+    }
+    return count;
+}
@@ -0,0 +1,61 @@
+#ifndef FONTMETRICS_HPP_INCLUDED
+#define FONTMETRICS_HPP_INCLUDED
+
+#include "fontfile.hpp"
+#include "glyph.hpp"
+#include "types.hpp"
+
+#include <vector>
+
+// Metrics of every glyph in a face, read once, for text layout without
+// constructing any Glyph. Values are in font units and come straight from the
+// font's tables (see TrueTypeFont::loadMetrics), so no outline is decoded:
+// advances are those of 'hmtx', while bearings and sizes follow the bounding
+// box in each glyph's header rather than that of its points. They are stored
+// as one array per field so that measuring runs of text only streams through
+// the fields it uses.
+class FontMetricsTable
+{
+public:
+    // Only TrueType outlines ('glyf') are read; throws std::runtime_error for
+    // other faces, e.g. CFF ones.
+    FontMetricsTable(const FontFace& face);
+
+    const FontInfo& font() const { return m_font; }
+    size_t glyphCount() const { return m_xAdvance.size(); }
+    // Glyphs whose data could not be read; their metrics are all zero.
+    const std::vector<U32>& failedGlyphs() const { return m_failed; }
+
+    int xAdvance(U32 glyph) const { return m_xAdvance[glyph]; }
+    int yAdvance(U32 glyph) const { return m_yAdvance[glyph]; }
+    int hBearingX(U32 glyph) const { return m_hBearingX[glyph]; }
+    int hBearingY(U32 glyph) const { return m_hBearingY[glyph]; }
+    int vBearingX(U32 glyph) const { return m_vBearingX[glyph]; }
+    int vBearingY(U32 glyph) const { return m_vBearingY[glyph]; }
+    int width(U32 glyph) const { return m_width[glyph]; }
+    int height(U32 glyph) const { return m_height[glyph]; }
+
+    // All metrics of one glyph in the layout of Glyph::info() before the
+    // outline is translated. Advances agree with Glyph; bearings and sizes
+    // can differ by a few units where the header box is not tight.
+    Glyph::GlyphInfo info(U32 glyph) const;
+
+    // Sum of the horizontal advances of the given glyphs.
+    S64 measure(const U32* glyphs, size_t count) const;
+    // Number of leading glyphs whose advances fit within 'width'.
+    size_t fit(const U32* glyphs, size_t count, S64 width) const;
+
+private:
+    FontInfo m_font;
+    std::vector<S32> m_xAdvance;
+    std::vector<S32> m_yAdvance;
+    std::vector<S32> m_hBearingX;
+    std::vector<S32> m_hBearingY;
+    std::vector<S32> m_vBearingX;
+    std::vector<S32> m_vBearingY;
+    std::vector<S32> m_width;
+    std::vector<S32> m_height;
+    std::vector<U32> m_failed;
+};
+
+#endif // FONTMETRICS_HPP_INCLUDED
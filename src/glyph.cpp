@@ -1,14 +1,20 @@
 #include "glyph.hpp"
 #include "common.hpp"
+#include "glyphcache.hpp"
 #include "matrix2.hpp"
 #include "primitives.hpp"
+#include "timer.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <stdexcept>
+#include <thread>
 
-Glyph::Glyph(FT_Outline outline, FT_Glyph_Metrics metrics)
+Glyph::Glyph(FT_Outline outline, FT_Glyph_Metrics metrics,
+             OutlineCache* cache, bool levels)
 {
     std::vector<size_t> contourEnd(outline.n_contours);
     std::vector<ivec2> position;
@@ -67,17 +73,19 @@ Glyph::Glyph(FT_Outline outline, FT_Glyph_Metrics metrics)
     m_info.vCursorY = static_cast<int>(metrics.vertBearingY);
     m_info.yAdvance = static_cast<int>(metrics.vertAdvance);
 
-    extractOutlines(contourEnd, position, isControl);
+    extractOutlines(contourEnd, position, isControl, cache, levels);
 }
 
 
 void Glyph::extractOutlines(const std::vector<size_t>& contourEnd,
                             const std::vector<ivec2>& position,
-                            const std::vector<bool>& control)
+                            const std::vector<bool>& control,
+                            OutlineCache* cache, bool levels)
 {
     ivec2 offset{32767, 32767};
     size_t contourBegin = 0;
     std::vector<PackedBezier> curves;
+    std::vector<size_t> curveContourEnd;
     for (size_t contour = 0; contour < contourEnd.size(); ++contour)
     {
         auto prevIdx = contourEnd[contour]-1;
@@ -119,6 +127,7 @@ void Glyph::extractOutlines(const std::vector<size_t>& contourEnd,
             }
         }
         contourBegin = contourEnd[contour];
+        curveContourEnd.push_back(curves.size());
     }
 
     --offset.x;
@@ -141,24 +150,103 @@ void Glyph::extractOutlines(const std::vector<size_t>& contourEnd,
     size_t lutRes = 5;
     while (lutRes > 1 && (minDim >> lutRes) < 3) --lutRes;
 
+    m_buildTime = 0;
+    if (cache)
+    {
+        m_outline = cache->find(curves, m_info, levels);
+        if (m_outline) return;
+    }
+
+    Timer timer;
+    timer.start();
+    m_outline = std::make_shared<Outline>();
     processCurves(curves);
     createLookup(lutRes, curves);
+    if (levels) createLevels(lutRes, curves, curveContourEnd);
+    timer.stop();
+    m_buildTime = timer.duration();
+
+    if (cache) cache->insert(curves, m_info, levels, m_outline, m_buildTime);
 }
 
-void Glyph::processCurves(const std::vector<PackedBezier>& curves)
+namespace
+{
+
+S64 cross(ivec2 a, ivec2 b)
+{
+    return (S64)a.x * b.y - (S64)a.y * b.x;
+}
+
+S64 dot64(ivec2 a, ivec2 b)
 {
+    return (S64)a.x * b.x + (S64)a.y * b.y;
+}
+
+// vec2_t::operator== is meant for floating point types.
+bool samePoint(ivec2 a, ivec2 b)
+{
+    return a.x == b.x && a.y == b.y;
+}
+
+struct Segment
+{
+    ivec2 p, q, r;
+    bool line;
+};
+
+// Simplifies a list of curves in contour order, without changing the winding
+// number anywhere:
+// * Zero-length lines are removed.
+// * Consecutive collinear lines pointing the same way are merged.
+// A quadratic counts as a line when its control point lies on the chord between
+// the end points. Such curves keep their control point, but PackedBezier marks
+// them as lines, so that intersect() solves them linearly.
+std::vector<PackedBezier> simplifyCurves(const std::vector<PackedBezier>& curves)
+{
+    std::vector<Segment> segments;
     for (const auto& curve : curves)
     {
-        auto p = ivec2{curve.p0x, curve.p0y};
-        auto q = ivec2{curve.p1x, curve.p1y};
-        auto r = ivec2{curve.p2x, curve.p2y};
-        if (p.y != q.y || q.y != r.y)
+        Segment s{ivec2{curve.p0x, curve.p0y}, ivec2{curve.p1x, curve.p1y},
+                  ivec2{curve.p2x, curve.p2y}, false};
+        s.line = cross(s.q - s.p, s.r - s.p) == 0
+              && dot64(s.q - s.p, s.r - s.q) >= 0;
+        if (s.line && samePoint(s.p, s.r)) continue;
+
+        if (s.line && !segments.empty())
         {
-            m_curves.emplace_back(p, q, r);
+            auto& prev = segments.back();
+            if (prev.line && samePoint(prev.r, s.p)
+                && cross(prev.r - prev.p, s.r - s.p) == 0
+                && dot64(prev.r - prev.p, s.r - s.p) > 0)
+            {
+                prev.r = s.r;
+                continue;
+            }
         }
+        segments.push_back(s);
     }
 
-    sortByY(m_curves);
+    std::vector<PackedBezier> simplified;
+    for (const auto& s : segments)
+    {
+        simplified.emplace_back(s.p, s.q, s.r);
+    }
+    return simplified;
+}
+
+} // End anonymous namespace
+
+void Glyph::processCurves(const std::vector<PackedBezier>& curves)
+{
+    for (const auto& curve : simplifyCurves(curves))
+    {
+        if (curve.p0y != curve.p1y || curve.p1y != curve.p2y)
+        {
+            m_outline->curves.push_back(curve);
+        }
+    }
+
+    sortByY(m_outline->curves);
 }
 
 void Glyph::sortByY(std::vector<PackedBezier>& curves)
@@ -171,8 +259,26 @@ void Glyph::sortByY(std::vector<PackedBezier>& curves)
               });
 }
 
+size_t Glyph::Outline::memoryUsage() const
+{
+    size_t levelBytes = levels.capacity() * sizeof(Level);
+    for (const auto& level : levels)
+    {
+        levelBytes += level.outline->memoryUsage();
+    }
+    return sizeof(Outline)
+         + curves.capacity() * sizeof(PackedBezier)
+         + bitmap.byteLength() * bitmap.rows()
+         + rowIndices.capacity() * sizeof(size_t)
+         + cellIndex.capacity() * sizeof(U16)
+         + cells.capacity() * sizeof(Cell)
+         + cellEntries.capacity() * sizeof(U32)
+         + levelBytes;
+}
+
 void Glyph::dumpInfo() const
 {
+    const auto& curves = m_outline->curves;
     std::cout << "=== Glyph outline ===\n";
     std::cout << "BBox: " << m_info.width << "x" << m_info.height << "\n";
     std::cout << "Horizontal mode offset: (" << m_info.hCursorX << ", "
@@ -181,13 +287,18 @@ void Glyph::dumpInfo() const
     std::cout << "Vertical mode offset: (" << m_info.vCursorX << ", "
               << m_info.vCursorY << ")\n";
     std::cout << "Vertical mode advance: " << m_info.yAdvance << "\n";
-    std::cout << "Bezier count: " << m_curves.size() << std::endl;
-    for (size_t i = 0; i < m_curves.size(); ++i)
+    std::cout << "Bezier count: " << curves.size() << std::endl;
+    for (const auto& level : m_outline->levels)
+    {
+        std::cout << "Level of detail (error " << level.error << "): "
+                  << level.outline->curves.size() << " Beziers\n";
+    }
+    for (size_t i = 0; i < curves.size(); ++i)
     {
         std::cout << "Bezier #" << i << ": ";
-        std::cout << "[(" << m_curves[i].p0x << ", " << m_curves[i].p0y << "), "
-                  <<  "(" << m_curves[i].p1x << ", " << m_curves[i].p1y << "), "
-                  <<  "(" << m_curves[i].p2x << ", " << m_curves[i].p2y << ")]"
+        std::cout << "[(" << curves[i].p0x << ", " << curves[i].p0y << "), "
+                  <<  "(" << curves[i].p1x << ", " << curves[i].p1y << "), "
+                  <<  "(" << curves[i].p2x << ", " << curves[i].p2y << ")]"
                   << std::endl;
 
     }
@@ -197,26 +308,30 @@ void Glyph::dumpInfo() const
 void Glyph::createLookup(size_t logLength,
                          const std::vector<PackedBezier>& curves)
 {
-    m_bitmap.setResolution(logLength);
+    auto& bitmap = m_outline->bitmap;
+    auto& boxLength = m_outline->boxLength;
+    auto& rowIndices = m_outline->rowIndices;
+
+    bitmap.setResolution(logLength);
     size_t length = 1 << logLength;
     // We add two to maximum dimension since boxes are half-open and zero
     // coordinates are reserved.
     size_t maxDim = std::max(m_info.width, m_info.height)+1;
-    m_boxLength = maxDim / length + (maxDim % length ? 1 : 0);
+    boxLength = maxDim / length + (maxDim % length ? 1 : 0);
 
-    m_rowindices.resize(length+1);
+    rowIndices.resize(length+1);
     size_t nextRow = 0;
-    m_rowindices[0] = 0;
-    for (size_t i = 0; i < m_curves.size(); ++i)
+    rowIndices[0] = 0;
+    for (size_t i = 0; i < m_outline->curves.size(); ++i)
     {
-        while ((int)(m_boxLength * nextRow) <= m_curves[i].maxY())
+        while ((int)(boxLength * nextRow) <= m_outline->curves[i].maxY())
         {
-            m_rowindices[nextRow++] = i;
+            rowIndices[nextRow++] = i;
         }
     }
-    for (size_t i = nextRow; i < m_rowindices.size(); ++i)
+    for (size_t i = nextRow; i < rowIndices.size(); ++i)
     {
-        m_rowindices[i] = m_rowindices[nextRow];
+        rowIndices[i] = rowIndices[nextRow];
     }
 
     for (auto& yCurve : curves)
@@ -234,24 +349,24 @@ void Glyph::createLookup(size_t logLength,
         // v Gives problems with some glyphs when boxes and glyph lines are
         //   aligned.
         // pmax -= ivec2{1, 1};
-        pmin /= m_boxLength;
-        pmax /= m_boxLength;
-        if ((size_t)pmax.x >= m_bitmap.width()) --pmax.x;
-        if ((size_t)pmax.y >= m_bitmap.rows()) --pmax.y;
+        pmin /= boxLength;
+        pmax /= boxLength;
+        if ((size_t)pmax.x >= bitmap.width()) --pmax.x;
+        if ((size_t)pmax.y >= bitmap.rows()) --pmax.y;
 
-        if (xDegenerate && yCurve.p0x % m_boxLength != m_boxLength-1)
+        if (xDegenerate && yCurve.p0x % boxLength != boxLength-1)
         {
             for (int y = pmin.y; y <= pmax.y; ++y)
             {
-                m_bitmap.setValue(pmin.x, y, 2);
+                bitmap.setValue(pmin.x, y, 2);
             }
             continue;
         }
-        if (yDegenerate && yCurve.p0y % m_boxLength != 0)
+        if (yDegenerate && yCurve.p0y % boxLength != 0)
         {
             for (int x = pmin.x; x <= pmax.x; ++x)
             {
-                m_bitmap.setValue(x, pmin.y, 2);
+                bitmap.setValue(x, pmin.y, 2);
             }
             continue;
         }
@@ -273,9 +388,9 @@ void Glyph::createLookup(size_t logLength,
         // Where A, B and C are the control points. Here they span multiple
         // cells, but the curve lies completely inside one cell. Therefore we
         // should make sure that this cell is 'coloured'.
-        m_bitmap.setValue((size_t)(yCurve.p0x-1) / m_boxLength,
-                          (size_t)(yCurve.p0y-1) / m_boxLength,
-                          2);
+        bitmap.setValue((size_t)(yCurve.p0x-1) / boxLength,
+                        (size_t)(yCurve.p0y-1) / boxLength,
+                        2);
 
         // Of course if only one box is spanned entirely then there will be no
         // intersections (and it has already been coloured), so we can simply
@@ -288,19 +403,19 @@ void Glyph::createLookup(size_t logLength,
         for (int y = pmin.y; y <= pmax.y; ++y)
         {
             if (yDegenerate) break;
-            vec2 rayOrigin{(float)(pmin.x * (int)m_boxLength),
-                           (float)((y+1) * (int)m_boxLength)};
+            vec2 rayOrigin{(float)(pmin.x * (int)boxLength),
+                           (float)((y+1) * (int)boxLength)};
             float h[] = {0.f, 0.f, 0.f, 0.f};
             intersect(rayOrigin, yCurve, h[0], h[1]);
             intersect(rayOrigin-vec2{0, 0.01f}, yCurve, h[2], h[3]);
             for (size_t i = 0; i < sizeof(h)/sizeof(h[0]); ++i)
             {
                 if (h[i] <= 0.f) continue;
-                size_t hx = h[i] / m_boxLength;
-                if (hx < m_bitmap.width())
+                size_t hx = (size_t)(h[i] / boxLength);
+                if (hx < bitmap.width())
                 {
-                    m_bitmap.setValue(hx, y, 2);
-                    if ((size_t)y+1 < m_bitmap.rows()) m_bitmap.setValue(hx, y+1, 2);
+                    bitmap.setValue(hx, y, 2);
+                    if ((size_t)y+1 < bitmap.rows()) bitmap.setValue(hx, y+1, 2);
                 }
             }
         }
@@ -309,43 +424,347 @@ void Glyph::createLookup(size_t logLength,
         for (int x = pmin.x; x <= pmax.x; ++x)
         {
             if (xDegenerate) break;
-            vec2 rayOrigin{(float)((pmax.y) * (int)m_boxLength),
-                           (float)((x+1) * (int)m_boxLength)};
+            vec2 rayOrigin{(float)((pmax.y) * (int)boxLength),
+                           (float)((x+1) * (int)boxLength)};
             float h[] = {0.f, 0.f, 0.f, 0.f};
             intersect(rayOrigin, xCurve, h[0], h[1]);
             intersect(rayOrigin-vec2{0, 0.01f}, xCurve, h[2], h[3]);
             for (size_t i = 0; i < sizeof(h)/sizeof(h[0]); ++i)
             {
                 if (h[i] <= 0.f) continue;
-                size_t hy = h[i] / m_boxLength;
-                if (hy < m_bitmap.rows())
+                size_t hy = (size_t)(h[i] / boxLength);
+                if (hy < bitmap.rows())
+                {
+                    bitmap.setValue(x, hy, 2);
+                    if ((size_t)x+1 < bitmap.width()) bitmap.setValue(x+1, hy, 2);
+                }
+            }
+        }
+    }
+
+    for (size_t x = 0; x < bitmap.width(); ++x)
+    {
+        for (size_t y = 0; y < bitmap.rows(); ++y)
+        {
+            vec2 pos{(float)((x+0.5f)*boxLength), (float)((y+0.5f)*boxLength)};
+            if (bitmap(x, y) != 2)
+            {
+                bitmap.setValue(x, y, 2);
+                bitmap.setValue(x, y, isInside(pos));
+                if (bitmap(x, y) == 3)
                 {
-                    m_bitmap.setValue(x, hy, 2);
-                    if ((size_t)x+1 < m_bitmap.width()) m_bitmap.setValue(x+1, hy, 2);
+                    bitmap.setValue(x, y, 2);
+                    bitmap.setValue(x, y, isInside(pos));
                 }
             }
         }
     }
 
-    for (size_t x = 0; x < m_bitmap.width(); ++x)
+    createCells();
+}
+
+namespace
+{
+
+// Adds delta to the step at height y in a list sorted by height.
+void addStep(std::vector<std::pair<int, int>>& steps, int y, int delta)
+{
+    auto it = std::lower_bound(steps.begin(), steps.end(),
+                               std::make_pair(y, std::numeric_limits<int>::min()));
+    if (it != steps.end() && it->first == y) it->second += delta;
+    else steps.insert(it, std::make_pair(y, delta));
+}
+
+// Whether intersect() counts a curve wholly left of points with heights in
+// [y0, y1] exactly when the point lies in the half-open span of heights of
+// the curve's end points. Its lookup table ensures this, except where the
+// discriminant is so close to zero that rounding may flip its sign.
+bool countsAsStep(const PackedBezier& curve, int y0, int y1)
+{
+    S32 B = curve.p1y-curve.p0y;
+    S32 A = B+curve.p1y-curve.p2y;
+    // The discriminant's sign is then exact.
+    if (A == 0 || B == 0) return true;
+    double lo = std::max(y0, (int)std::min(curve.p0y, curve.p2y));
+    double hi = std::min(y1, (int)std::max(curve.p0y, curve.p2y));
+    if (lo > hi) return true;
+    // The discriminant is linear in the height, and zero at the extremum.
+    double extremum = curve.p0y + B * (double)B / A;
+    double distance = std::max(0., std::max(lo - extremum, extremum - hi));
+    double C = std::max(std::abs(curve.p0y - y0), std::abs(curve.p0y - y1)) + 1.;
+    return std::abs(A) * distance > (B * (double)B + std::abs(A) * C) * 1e-5;
+}
+
+} // End anonymous namespace
+
+void Glyph::createCells()
+{
+    const auto& curves = m_outline->curves;
+    const auto& bitmap = m_outline->bitmap;
+    const auto& rowIndices = m_outline->rowIndices;
+    auto& cellIndex = m_outline->cellIndex;
+    auto& cells = m_outline->cells;
+    auto& cellEntries = m_outline->cellEntries;
+    int boxLength = m_outline->boxLength;
+
+    cellIndex.assign(bitmap.width() * bitmap.rows(), 0);
+    std::vector<U32> rowCurves;
+    std::vector<std::pair<int, int>> steps;
+    std::vector<U32> inCell;
+    std::vector<U32> left;
+    for (size_t y = 0; y < bitmap.rows(); ++y)
     {
-        for (size_t y = 0; y < m_bitmap.rows(); ++y)
+        // Points resolved through this row lie within these heights; the
+        // margin of one unit absorbs rounding in finding the cell.
+        int y0 = y * boxLength - 1;
+        int y1 = (y + 1) * boxLength + 1;
+
+        // isInside() scans from the same curve, so both agree exactly.
+        rowCurves.clear();
+        for (size_t i = rowIndices[y]; i < curves.size(); ++i)
         {
-            vec2 pos{(float)((x+0.5f)*m_boxLength), (float)((y+0.5f)*m_boxLength)};
-            if (m_bitmap(x, y) != 2)
+            if (curves[i].minY() > y1) break;
+            if (curves[i].maxY() >= y0) rowCurves.push_back(i);
+        }
+        // Sweeping the cells from left to right, curves are moved into the
+        // steps as the cells pass them.
+        std::sort(rowCurves.begin(), rowCurves.end(),
+                  [&curves](U32 a, U32 b)
+                  {
+                      return curves[a].maxX() < curves[b].maxX();
+                  });
+        size_t nextLeft = 0;
+        steps.clear();
+        left.clear();
+
+        for (size_t x = 0; x < bitmap.width(); ++x)
+        {
+            if (bitmap(x, y) != 2) continue;
+
+            int x0 = m_info.hCursorX + x * boxLength - 1;
+            int x1 = m_info.hCursorX + (x + 1) * boxLength + 1;
+
+            // Curves wholly left of the cell count exactly when the point lies
+            // in their half-open span of heights; see countsAsStep(). Steps of
+            // consecutive curves along a contour cancel.
+            for (; nextLeft < rowCurves.size()
+                   && curves[rowCurves[nextLeft]].maxX() < x0; ++nextLeft)
+            {
+                const auto& curve = curves[rowCurves[nextLeft]];
+                if (!countsAsStep(curve, y0, y1))
+                {
+                    left.push_back(rowCurves[nextLeft]);
+                    continue;
+                }
+                int sign = curve.p2y > curve.p0y ? -1 : 1;
+                addStep(steps, std::min(curve.p0y, curve.p2y), sign);
+                addStep(steps, std::max(curve.p0y, curve.p2y), -sign);
+            }
+
+            Outline::Cell cell{(U32)cellEntries.size(), 0, 0, 0};
+            for (const auto& step : steps)
+            {
+                if (!step.second || step.first >= y1) continue;
+                if (step.first < y0)
+                {
+                    cell.winding += step.second;
+                    continue;
+                }
+                cellEntries.push_back((U32)step.first << 16
+                                      | (U16)(S16)step.second);
+                ++cell.steps;
+            }
+
+            inCell.assign(left.begin(), left.end());
+            for (size_t i = nextLeft; i < rowCurves.size(); ++i)
             {
-                m_bitmap.setValue(x, y, 2);
-                m_bitmap.setValue(x, y, isInside(pos));
-                if (m_bitmap(x, y) == 3)
+                if (curves[rowCurves[i]].minX() <= x1)
                 {
-                    m_bitmap.setValue(x, y, 2);
-                    m_bitmap.setValue(x, y, isInside(pos));
+                    inCell.push_back(rowCurves[i]);
                 }
             }
+            cellEntries.insert(cellEntries.end(), inCell.begin(), inCell.end());
+            cell.curves = inCell.size();
+            cellIndex[y * bitmap.width() + x] = cells.size();
+            cells.push_back(cell);
         }
     }
 }
 
+namespace
+{
+
+double segmentDistance(ivec2 point, ivec2 a, ivec2 b)
+{
+    double dx = b.x - a.x, dy = b.y - a.y;
+    double px = point.x - a.x, py = point.y - a.y;
+    double lengthSq = dx * dx + dy * dy;
+    double t = lengthSq > 0 ? std::max(0., std::min(1., (px*dx + py*dy) / lengthSq))
+                            : 0.;
+    return std::hypot(px - t * dx, py - t * dy);
+}
+
+// Signed area enclosed by the curves [first, last) of a closed contour: that of
+// the polygon through their end points, plus two thirds of the triangle which
+// each curve spans with its chord.
+double contourArea(const std::vector<PackedBezier>& curves, size_t first,
+                   size_t last)
+{
+    double area = 0.;
+    for (size_t i = first; i < last; ++i)
+    {
+        const auto& c = curves[i];
+        area += (double)c.p0x * c.p2y - (double)c.p2x * c.p0y;
+        area += 2. / 3. * ((double)(c.p1x - c.p0x) * (c.p2y - c.p0y)
+                           - (double)(c.p2x - c.p0x) * (c.p1y - c.p0y));
+    }
+    return area / 2.;
+}
+
+// Douglas-Peucker over curves rather than points: the curves [first, last) of
+// a contour are replaced by the chord between their ends if no control point
+// lies farther than maxError from it. Since each curve lies in the convex hull
+// of its control points, the whole run then lies within maxError of the chord,
+// and as the run connects the chord's ends, the chord lies within maxError of
+// the run. Otherwise the run is split at the farthest control point.
+void simplifyRun(const std::vector<PackedBezier>& curves, size_t first,
+                 size_t last, double maxError, std::vector<PackedBezier>& out)
+{
+    ivec2 start{curves[first].p0x, curves[first].p0y};
+    ivec2 end{curves[last-1].p2x, curves[last-1].p2y};
+    double farthest = 0.;
+    size_t split = first;
+    for (size_t i = first; i < last; ++i)
+    {
+        double control = segmentDistance(ivec2{curves[i].p1x, curves[i].p1y},
+                                         start, end);
+        double anchor = segmentDistance(ivec2{curves[i].p2x, curves[i].p2y},
+                                        start, end);
+        if (control > farthest)
+        {
+            farthest = control;
+            split = i > first ? i : i + 1;
+        }
+        if (anchor > farthest)
+        {
+            farthest = anchor;
+            split = i + 1 < last ? i + 1 : i;
+        }
+    }
+    if (farthest <= maxError)
+    {
+        out.emplace_back(start, start, end);
+        return;
+    }
+    if (last - first == 1)
+    {
+        out.push_back(curves[first]);
+        return;
+    }
+    simplifyRun(curves, first, split, maxError, out);
+    simplifyRun(curves, split, last, maxError, out);
+}
+
+} // End anonymous namespace
+
+void Glyph::createLevels(size_t logLength,
+                         const std::vector<PackedBezier>& curves,
+                         const std::vector<size_t>& contourEnd)
+{
+    // Simple glyphs are cheap to test at any size.
+    const size_t minCurves = 64;
+    if (m_outline->curves.size() < minCurves) return;
+
+    // Errors from 1/256 to 1/32 of the glyph's size; with a quarter pixel
+    // allowed, these serve glyphs from about 64 down to 8 pixels in size.
+    float maxDim = std::max(m_info.width, m_info.height);
+    auto full = m_outline;
+    size_t previousCount = full->curves.size();
+    for (float divisor = 256.f; divisor >= 32.f; divisor /= 2.f)
+    {
+        float error = maxDim / divisor;
+        // Below one unit there is nothing to simplify on the integer grid.
+        if (error < 1.f) continue;
+        std::vector<PackedBezier> simplified;
+        size_t contourBegin = 0;
+        for (auto end : contourEnd)
+        {
+            if (end > contourBegin)
+            {
+                size_t first = simplified.size();
+                simplifyRun(curves, contourBegin, end, error, simplified);
+                // Small contours such as dots and diacritics may collapse to
+                // little or nothing; those are kept unchanged.
+                double area = contourArea(simplified, first, simplified.size());
+                double original = contourArea(curves, contourBegin, end);
+                if (std::abs(area) < std::abs(original) / 2.)
+                {
+                    simplified.resize(first);
+                    simplified.insert(simplified.end(), curves.begin() + contourBegin,
+                                      curves.begin() + end);
+                }
+            }
+            contourBegin = end;
+        }
+
+        // The level's grid is built by the same code as the full one, which
+        // works on m_outline.
+        m_outline = std::make_shared<Outline>();
+        processCurves(simplified);
+        if (4 * m_outline->curves.size() <= 3 * previousCount)
+        {
+            createLookup(logLength, simplified);
+            previousCount = m_outline->curves.size();
+            full->levels.push_back({error, m_outline});
+        }
+        m_outline = full;
+    }
+}
+
+Glyph Glyph::levelOfDetail(float maxError) const
+{
+    Glyph glyph(*this);
+    for (const auto& level : m_outline->levels)
+    {
+        if (level.error > maxError) break;
+        glyph.m_outline = level.outline;
+    }
+    return glyph;
+}
+
+namespace
+{
+
+// The winding one curve adds at pos. Every query goes through here, so all of
+// them skip the same curves and agree on every point.
+inline int curveWinding(vec2 pos, const PackedBezier& curve) noexcept
+{
+    if (curve.minY() > pos.y || curve.maxY() < pos.y) return 0;
+    if (curve.minX() > pos.x) return 0;
+    float minusX, plusX;
+    return intersect(pos, curve, minusX, plusX);
+}
+
+} // End anonymous namespace
+
+int Glyph::cellWinding(size_t x, size_t y, vec2 pos) const noexcept
+{
+    const auto& curves = m_outline->curves;
+    const auto& cell = m_outline->cells[m_outline->cellIndex[y * m_outline->bitmap.width() + x]];
+    const U32* entry = &m_outline->cellEntries[cell.first];
+
+    int winding = cell.winding;
+    for (U16 i = 0; i < cell.steps; ++i, ++entry)
+    {
+        winding += (pos.y > (S16)(*entry >> 16)) * (S16)(*entry & 0xffff);
+    }
+    for (U16 i = 0; i < cell.curves; ++i, ++entry)
+    {
+        winding += curveWinding(pos, curves[*entry]);
+    }
+    return winding;
+}
+
 // (minusX, plusX) contains the (up to) two places where the ray and the curve
 // intersects. A zero means there's no intersection.
 int intersect(vec2 pos, PackedBezier bezier, float& minusX, float& plusX) noexcept
@@ -355,7 +774,24 @@ int intersect(vec2 pos, PackedBezier bezier, float& minusX, float& plusX) noexce
     S16 B = bezier.p1y-bezier.p0y;
     S16 A = B+bezier.p1y-bezier.p2y;
 
-    auto lookup = (bezier.lookup>>(2*(C>=0)+4*(K>=0)))&3;
+    auto lookup = (bezier.lookup>>(2*(C>=0)+4*(K>=0))) & 3;
+    if (!lookup)
+    {
+        minusX = plusX = 0;
+        return 0;
+    }
+
+    if (bezier.lookup & PackedBezier::lineBit)
+    {
+        // The lookup still tells which side of the ray counts; the valid root
+        // is the single crossing.
+        float x = C / (float)(bezier.p0y-bezier.p2y) * (bezier.p2x-bezier.p0x);
+        float G = bezier.p0x-pos.x;
+        minusX = (x+bezier.p0x) * (lookup&1);
+        plusX = (x+bezier.p0x) * ((lookup&2)>>1);
+        return (x + G <= 0) * (lookup&1)
+             - (x + G <= 0) * ((lookup&2)>>1);
+    }
 
     float tMinus, tPlus;
     if (A == 0)
@@ -371,7 +807,7 @@ int intersect(vec2 pos, PackedBezier bezier, float& minusX, float& plusX) noexce
     }
     else
     {
-        tMinus = tPlus = 0;
+        minusX = plusX = 0;
         return 0;
     }
 
@@ -422,28 +858,212 @@ int intersect(vec2 pos, PackedBezier bezier, float& minusX, float& plusX) noexce
 
 bool Glyph::isInside(vec2 pos) const noexcept
 {
-    int y = pos.y / m_boxLength;
-    int x = (pos.x - m_info.hCursorX) / m_boxLength;
-    int v = 2;
+    const auto& curves = m_outline->curves;
+    const auto& bitmap = m_outline->bitmap;
+    auto boxLength = m_outline->boxLength;
+    const auto& rowIndices = m_outline->rowIndices;
+
+    int y = (int)(pos.y / boxLength);
+    int x = (int)((pos.x - m_info.hCursorX) / boxLength);
     if (pos.x >= 1 && pos.x <= m_info.width &&
         pos.y >= 1 && pos.y <= m_info.height)
     {
-        v = m_bitmap(x, y);
+        int v = bitmap(x, y);
+        if (v != 2) return v;
+        // While the lookup is built, cells are not yet available.
+        if (!m_outline->cells.empty()) return cellWinding(x, y, pos) != 0;
     }
-    if (v != 2) return v;
     int intersections = 0;
-    for (size_t i = m_rowindices[y]; i < m_curves.size(); ++i)
+    for (size_t i = rowIndices[y]; i < curves.size(); ++i)
     {
-        const auto& curve = m_curves[i];
-        if (curve.minY() > pos.y) break;
-        if (curve.maxY() < pos.y) continue;
-        if (curve.minX() > pos.x) continue;
-        float dummy;
-        intersections += intersect(pos, curve, dummy, dummy);
+        if (curves[i].minY() > pos.y) break;
+        intersections += curveWinding(pos, curves[i]);
     }
     return intersections;
 }
 
+template <typename Output>
+void Glyph::batchInside(const vec2* points, size_t count, Output out) const
+{
+    const auto& curves = m_outline->curves;
+    const auto& bitmap = m_outline->bitmap;
+    auto boxLength = m_outline->boxLength;
+    const auto& rowIndices = m_outline->rowIndices;
+    const auto& cells = m_outline->cells;
+    const auto& cellEntries = m_outline->cellEntries;
+    int lastRow = (int)rowIndices.size()-1;
+
+    // Resolve what the lookup grid can. As in isInside(), the rest is resolved
+    // through its mixed cell, or by scanning its row band if it lies off the
+    // grid; points are grouped by cell and then by band.
+    std::vector<U32> groupStart(cells.size()+rowIndices.size()+1, 0);
+    std::vector<U32> group(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        vec2 pos = points[i];
+        int y = (int)(pos.y / boxLength);
+        int x = (int)((pos.x - m_info.hCursorX) / boxLength);
+        group[i] = cells.size() + std::max(0, std::min(y, lastRow));
+        if (pos.x >= 1 && pos.x <= m_info.width &&
+            pos.y >= 1 && pos.y <= m_info.height)
+        {
+            U32 v = bitmap(x, y);
+            if (v != 2)
+            {
+                out(i, v != 0);
+                group[i] = groupStart.size();
+                continue;
+            }
+            if (!cells.empty())
+            {
+                group[i] = m_outline->cellIndex[y * bitmap.width() + x];
+            }
+        }
+        ++groupStart[group[i]+1];
+    }
+    for (size_t g = 1; g < groupStart.size(); ++g) groupStart[g] += groupStart[g-1];
+    std::vector<U32> order(groupStart.back());
+    {
+        auto next = groupStart;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (group[i] < groupStart.size()) order[next[group[i]]++] = i;
+        }
+    }
+
+    // Each curve is tested against all points of a group in turn.
+    std::vector<vec2> pos;
+    std::vector<int> winding;
+    for (size_t g = 0; g+1 < groupStart.size(); ++g)
+    {
+        size_t first = groupStart[g], last = groupStart[g+1];
+        if (first == last) continue;
+        size_t n = last - first;
+        pos.resize(n);
+        float minY = std::numeric_limits<float>::max();
+        float maxY = -minY;
+        for (size_t j = 0; j < n; ++j)
+        {
+            pos[j] = points[order[first+j]];
+            minY = std::min(minY, pos[j].y);
+            maxY = std::max(maxY, pos[j].y);
+        }
+
+        if (g < cells.size())
+        {
+            // See cellWinding().
+            const auto& cell = cells[g];
+            const U32* entry = &cellEntries[cell.first];
+            winding.assign(n, cell.winding);
+            for (U16 i = 0; i < cell.steps; ++i, ++entry)
+            {
+                float stepY = (S16)(*entry >> 16);
+                int delta = (S16)(*entry & 0xffff);
+                for (size_t j = 0; j < n; ++j)
+                {
+                    winding[j] += (pos[j].y > stepY) * delta;
+                }
+            }
+            for (U16 i = 0; i < cell.curves; ++i, ++entry)
+            {
+                const auto& curve = curves[*entry];
+                if (curve.minY() > maxY || curve.maxY() < minY) continue;
+                for (size_t j = 0; j < n; ++j)
+                {
+                    winding[j] += curveWinding(pos[j], curve);
+                }
+            }
+        }
+        else
+        {
+            winding.assign(n, 0);
+            for (size_t i = rowIndices[g-cells.size()]; i < curves.size(); ++i)
+            {
+                const auto& curve = curves[i];
+                if (curve.minY() > maxY) break;
+                if (curve.maxY() < minY) continue;
+                for (size_t j = 0; j < n; ++j)
+                {
+                    winding[j] += curveWinding(pos[j], curve);
+                }
+            }
+        }
+
+        for (size_t j = 0; j < n; ++j) out(order[first+j], winding[j] != 0);
+    }
+}
+
+void Glyph::isInside(const vec2* points, size_t count, U8* out) const
+{
+    batchInside(points, count, [out](size_t i, bool inside)
+                {
+                    out[i] = inside;
+                });
+}
+
+void Glyph::isInside(const vec2* points, size_t count, U64* bits) const
+{
+    std::fill(bits, bits + (count + 63) / 64, 0);
+    batchInside(points, count, [bits](size_t i, bool inside)
+                {
+                    bits[i >> 6] |= (U64)inside << (i & 63);
+                });
+}
+
+int Glyph::uniformValue(vec2 lo, vec2 hi) const noexcept
+{
+    // Outside this window isInside() ignores the bitmap.
+    if (lo.x < 1 || hi.x > m_info.width || lo.y < 1 || hi.y > m_info.height)
+    {
+        return -1;
+    }
+    const auto& bitmap = m_outline->bitmap;
+    auto boxLength = m_outline->boxLength;
+
+    // Cells are found exactly as in isInside().
+    int x0 = (int)((lo.x - m_info.hCursorX) / boxLength);
+    int x1 = (int)((hi.x - m_info.hCursorX) / boxLength);
+    int y0 = (int)(lo.y / boxLength);
+    int y1 = (int)(hi.y / boxLength);
+    U32 v = bitmap(x0, y0);
+    if (v > 1) return -1;
+    for (int y = y0; y <= y1; ++y)
+    {
+        for (int x = x0; x <= x1; ++x)
+        {
+            if (bitmap(x, y) != v) return -1;
+        }
+    }
+    return v;
+}
+
+void Glyph::rowCrossings(float y, std::vector<Crossing>& crossings) const
+{
+    const auto& curves = m_outline->curves;
+    const auto& rowIndices = m_outline->rowIndices;
+
+    crossings.clear();
+    int row = std::max(0, std::min((int)(y / m_outline->boxLength),
+                                   (int)rowIndices.size()-1));
+    // Every crossing lies left of this point, so each one is reported.
+    vec2 pos{std::numeric_limits<float>::max(), y};
+    for (size_t i = rowIndices[row]; i < curves.size(); ++i)
+    {
+        const auto& curve = curves[i];
+        if (curve.minY() > y) break;
+        if (curve.maxY() < y) continue;
+        float minusX, plusX;
+        intersect(pos, curve, minusX, plusX);
+        if (minusX > 0) crossings.push_back({minusX, 1});
+        if (plusX > 0) crossings.push_back({plusX, -1});
+    }
+    std::sort(crossings.begin(), crossings.end(),
+              [](const Crossing& a, const Crossing& b)
+              {
+                  return a.x < b.x;
+              });
+}
+
 
 FontInfo::FontInfo(FT_Face face)
 {
@@ -461,10 +1081,12 @@ FontInfo::FontInfo(FT_Face face)
     underlineThickness = static_cast<int>(face->underline_thickness);
 }
 
-Image render(const FontInfo& info, const Glyph& glyph, int width, int height)
+namespace
 {
-    int pixelWidth, pixelHeight;
 
+void pixelSize(const FontInfo& info, const Glyph& glyph, int width, int height,
+               int& pixelWidth, int& pixelHeight)
+{
     if (width <= 0)
     {
         if (height <= 0)
@@ -481,19 +1103,369 @@ Image render(const FontInfo& info, const Glyph& glyph, int width, int height)
         if (pixelWidth < 2) pixelWidth = 2;
         pixelHeight = pixelWidth * glyph.info().height / glyph.info().width;
     }
+}
+
+// Sweeps the sorted crossings of a row once, calling out(i, winding) for each
+// of the 'samples' evenly spaced sample points across the glyph's width.
+template <typename Output>
+void sweepRow(const std::vector<Glyph::Crossing>& crossings,
+              const Glyph& glyph, size_t samples, Output out)
+{
+    size_t next = 0;
+    int winding = 0;
+    for (size_t i = 0; i < samples; ++i)
+    {
+        float glyphX = glyph.info().hCursorX + i*glyph.info().width/float(samples);
+        while (next < crossings.size() && crossings[next].x <= glyphX)
+        {
+            winding += crossings[next++].winding;
+        }
+        out(i, winding);
+    }
+}
+
+} // End anonymous namespace
+
+Image render(const FontInfo& info, const Glyph& glyph, int width, int height)
+{
+    return render(info, glyph, width, height, vec2{0.f, 0.f});
+}
+
+ivec2 renderSize(const FontInfo& info, const Glyph& glyph, int width, int height)
+{
+    int pixelWidth, pixelHeight;
+    pixelSize(info, glyph, width, height, pixelWidth, pixelHeight);
+    return ivec2{pixelWidth, pixelHeight};
+}
+
+Glyph levelForSize(const FontInfo& info, const Glyph& glyph, int width, int height)
+{
+    const float maxPixelError = 0.25f;
+    int pixelWidth, pixelHeight;
+    pixelSize(info, glyph, width, height, pixelWidth, pixelHeight);
+    float unitsPerPixel = std::min(glyph.info().width / float(pixelWidth),
+                                   glyph.info().height / float(pixelHeight));
+    return glyph.levelOfDetail(maxPixelError * unitsPerPixel);
+}
+
+void render(const FontInfo& info, const Glyph& glyph, int width, int height,
+            U8* buffer, size_t stride, size_t originX, size_t originY)
+{
+    int pixelWidth, pixelHeight;
+    pixelSize(info, glyph, width, height, pixelWidth, pixelHeight);
+
+    const auto& gi = glyph.info();
+    for (int y = 0; y < pixelHeight; ++y)
+    {
+        U8* out = buffer + (originY + y) * stride + 4 * originX;
+        float glyphY = gi.hCursorY - float(y)*gi.height/float(pixelHeight);
+        for (int x = 0; x < pixelWidth; ++x)
+        {
+            vec2 glyphPos{gi.hCursorX + float(x)*gi.width/float(pixelWidth),
+                          glyphY};
+            U8 value = glyph.isInside(glyphPos) ? 0xff : 0;
+            out[0] = out[1] = out[2] = value;
+            out[3] = 0xff;
+            out += 4;
+        }
+    }
+}
+
+Image render(const FontInfo& info, const Glyph& glyph, int width, int height,
+             ImagePool& pool)
+{
+    ivec2 size = renderSize(info, glyph, width, height);
+    Image img = pool.acquire(size.x, size.y);
+    render(info, glyph, width, height, img.p.data(), 4 * img.width, 0, 0);
+    return img;
+}
+
+Image render(const FontInfo& info, const Glyph& glyph, int width, int height,
+             vec2 offset)
+{
+    if (offset.x < 0.f || offset.x >= 1.f || offset.y < 0.f || offset.y >= 1.f)
+    {
+        throw std::domain_error("Subpixel offset must lie in [0, 1).");
+    }
+
+    int pixelWidth, pixelHeight;
+    pixelSize(info, glyph, width, height, pixelWidth, pixelHeight);
+
+    // A shifted glyph bleeds into one extra column (row) to the right (below).
+    int imageWidth = pixelWidth + (offset.x > 0.f);
+    int imageHeight = pixelHeight + (offset.y > 0.f);
+
+    Image img(imageWidth, imageHeight);
+
+    for (int y = imageHeight-1; y >= 0; --y)
+    {
+        for (int x = 0; x < imageWidth; ++x)
+        {
+            vec2 glyphPos;
+            glyphPos.x = glyph.info().hCursorX + (x-offset.x)*glyph.info().width/float(pixelWidth);
+            glyphPos.y = glyph.info().hCursorY - (y-offset.y)*glyph.info().height/float(pixelHeight);
+            auto inside = glyph.isInside(glyphPos);
+            img.setPixel(x, y, inside*0xffffff);
+        }
+    }
+    return img;
+}
+
+Image render(const FontInfo& info, const Glyph& glyph, int width, int height,
+             const mat2& transform, vec2 translation, ivec2& origin)
+{
+    if (std::abs(det(transform)) < 1e-6f)
+    {
+        throw std::domain_error("Singular render transform.");
+    }
+
+    int pixelWidth, pixelHeight;
+    pixelSize(info, glyph, width, height, pixelWidth, pixelHeight);
+
+    vec2 corners[] = {vec2{0.f, 0.f}, vec2{(float)pixelWidth, 0.f},
+                      vec2{0.f, (float)pixelHeight},
+                      vec2{(float)pixelWidth, (float)pixelHeight}};
+    vec2 boxMin = transform * corners[0] + translation;
+    vec2 boxMax = boxMin;
+    for (const auto& corner : corners)
+    {
+        vec2 c = transform * corner + translation;
+        boxMin.x = std::min(boxMin.x, c.x); boxMin.y = std::min(boxMin.y, c.y);
+        boxMax.x = std::max(boxMax.x, c.x); boxMax.y = std::max(boxMax.y, c.y);
+    }
+    origin = ivec2{(S32)std::floor(boxMin.x), (S32)std::floor(boxMin.y)};
+    int imageWidth = std::max(1, (int)std::ceil(boxMax.x) - origin.x);
+    int imageHeight = std::max(1, (int)std::ceil(boxMax.y) - origin.y);
+
+    Image img(imageWidth, imageHeight);
+
+    const auto& gi = glyph.info();
+    mat2 inv = inverse(transform);
+    for (int y = imageHeight-1; y >= 0; --y)
+    {
+        for (int x = 0; x < imageWidth; ++x)
+        {
+            vec2 q{(float)(x + origin.x), (float)(y + origin.y)};
+            vec2 p = inv * (q - translation);
+            vec2 glyphPos;
+            glyphPos.x = gi.hCursorX + p.x*gi.width/float(pixelWidth);
+            glyphPos.y = gi.hCursorY - p.y*gi.height/float(pixelHeight);
+            // Unlike the untransformed case, samples may map far outside the
+            // glyph's bounding box, where there is nothing to find.
+            bool inBox = glyphPos.x >= gi.hCursorX
+                      && glyphPos.x <= gi.hCursorX + gi.width
+                      && glyphPos.y >= gi.hCursorY - gi.height
+                      && glyphPos.y <= gi.hCursorY;
+            auto inside = inBox && glyph.isInside(glyphPos);
+            img.setPixel(x, y, inside*0xffffff);
+        }
+    }
+    return img;
+}
+
+Image renderLCD(const FontInfo& info, const Glyph& glyph, int width, int height,
+                const LcdFilter& filter)
+{
+    int pixelWidth, pixelHeight;
+    pixelSize(info, glyph, width, height, pixelWidth, pixelHeight);
+
+    U32 weightSum = 0;
+    for (auto w : filter.weights) weightSum += w;
+    if (!weightSum)
+    {
+        throw std::domain_error("LCD filter weights must not all be zero.");
+    }
 
     Image img(pixelWidth, pixelHeight);
 
+    // Two subpixels of padding on either side let the filter run without
+    // bounds checks.
+    size_t subWidth = 3 * pixelWidth;
+    std::vector<U32> coverage(subWidth + 4);
+    std::vector<Glyph::Crossing> crossings;
+
     for (int y = pixelHeight-1; y >= 0; --y)
     {
+        float glyphY = glyph.info().hCursorY - y*glyph.info().height/float(pixelHeight);
+        glyph.rowCrossings(glyphY, crossings);
+
+        sweepRow(crossings, glyph, subWidth,
+                 [&](size_t sx, int winding)
+                 {
+                     coverage[sx+2] = winding ? 255 : 0;
+                 });
+
+        for (int x = 0; x < pixelWidth; ++x)
+        {
+            U8 channel[3];
+            for (size_t c = 0; c < 3; ++c)
+            {
+                const U32* sub = &coverage[3*x+c];
+                U32 sum = 0;
+                for (size_t k = 0; k < 5; ++k) sum += sub[k] * filter.weights[k];
+                channel[c] = std::min<U32>(255, sum / weightSum);
+            }
+            if (filter.bgr) std::swap(channel[0], channel[2]);
+            img.setPixel(x, y, Colour(channel[0], channel[1], channel[2]));
+        }
+    }
+    return img;
+}
+
+std::vector<Image> renderSizes(const FontInfo& info, const Glyph& glyph,
+                               const std::vector<int>& sizes)
+{
+    std::vector<Image> images;
+    // Glyph-space height of a sample row -> (image, pixel row) pairs using it.
+    // Rows of different sizes that land on the same height share crossings.
+    std::map<float, std::vector<std::pair<size_t, int>>> rows;
+    for (size_t i = 0; i < sizes.size(); ++i)
+    {
+        int pixelWidth, pixelHeight;
+        pixelSize(info, glyph, 0, sizes[i], pixelWidth, pixelHeight);
+        images.emplace_back(pixelWidth, pixelHeight);
+        for (int y = 0; y < pixelHeight; ++y)
+        {
+            float glyphY = glyph.info().hCursorY - y*glyph.info().height/float(pixelHeight);
+            rows[glyphY].emplace_back(i, y);
+        }
+    }
+
+    std::vector<Glyph::Crossing> crossings;
+    for (const auto& row : rows)
+    {
+        glyph.rowCrossings(row.first, crossings);
+        for (const auto& use : row.second)
+        {
+            Image& img = images[use.first];
+            int y = use.second;
+            sweepRow(crossings, glyph, img.width,
+                     [&](size_t x, int winding)
+                     {
+                         img.setPixel(x, y, winding ? 0xffffff : 0);
+                     });
+        }
+    }
+    return images;
+}
+
+Image renderParallel(const FontInfo& info, const Glyph& glyph,
+                     int width, int height, unsigned threads)
+{
+    int pixelWidth, pixelHeight;
+    pixelSize(info, glyph, width, height, pixelWidth, pixelHeight);
+
+    Image img(pixelWidth, pixelHeight);
+
+    const int tileSize = 64;
+    int tilesX = (pixelWidth + tileSize - 1) / tileSize;
+    int tilesY = (pixelHeight + tileSize - 1) / tileSize;
+    size_t tileCount = tilesX * tilesY;
+    std::atomic<size_t> nextTile{0};
+
+    const auto& gi = glyph.info();
+    auto glyphPos = [&](int x, int y)
+    {
+        return vec2{gi.hCursorX + x*gi.width/float(pixelWidth),
+                    gi.hCursorY - y*gi.height/float(pixelHeight)};
+    };
+
+    // Tiles cover disjoint pixels, so workers write straight into the image.
+    auto worker = [&]()
+    {
+        for (size_t tile = nextTile++; tile < tileCount; tile = nextTile++)
+        {
+            int x0 = (tile % tilesX) * tileSize;
+            int y0 = (tile / tilesX) * tileSize;
+            int x1 = std::min(x0 + tileSize, pixelWidth);
+            int y1 = std::min(y0 + tileSize, pixelHeight);
+
+            vec2 topLeft = glyphPos(x0, y0);
+            vec2 bottomRight = glyphPos(x1-1, y1-1);
+            int uniform = glyph.uniformValue(vec2{topLeft.x, bottomRight.y},
+                                             vec2{bottomRight.x, topLeft.y});
+            for (int y = y1-1; y >= y0; --y)
+            {
+                for (int x = x0; x < x1; ++x)
+                {
+                    auto inside = uniform >= 0 ? uniform
+                                               : glyph.isInside(glyphPos(x, y));
+                    img.setPixel(x, y, inside*0xffffff);
+                }
+            }
+        }
+    };
+
+    if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<size_t>(threads, tileCount);
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; ++i) pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool) thread.join();
+
+    return img;
+}
+
+void renderStrips(const FontInfo& info, const Glyph& glyph,
+                  int width, int height, int stripHeight, StripSink& sink)
+{
+    if (stripHeight <= 0)
+    {
+        throw std::runtime_error("Bad strip height.");
+    }
+
+    int pixelWidth, pixelHeight;
+    pixelSize(info, glyph, width, height, pixelWidth, pixelHeight);
+
+    sink.begin(pixelWidth, pixelHeight);
+    Image strip(pixelWidth, std::min(stripHeight, pixelHeight));
+    for (int y0 = 0; y0 < pixelHeight; y0 += stripHeight)
+    {
+        int rows = std::min(stripHeight, pixelHeight - y0);
+        if ((size_t)rows != strip.height) strip = Image(pixelWidth, rows);
+        for (int y = 0; y < rows; ++y)
+        {
+            for (int x = 0; x < pixelWidth; ++x)
+            {
+                vec2 glyphPos;
+                glyphPos.x = glyph.info().hCursorX + x*glyph.info().width/float(pixelWidth);
+                glyphPos.y = glyph.info().hCursorY - (y0+y)*glyph.info().height/float(pixelHeight);
+                auto inside = glyph.isInside(glyphPos);
+                strip.setPixel(x, y, inside*0xffffff);
+            }
+        }
+        sink.write(strip, y0);
+    }
+    sink.end();
+}
+
+RleBitmap renderRle(const FontInfo& info, const Glyph& glyph,
+                    int width, int height)
+{
+    int pixelWidth, pixelHeight;
+    pixelSize(info, glyph, width, height, pixelWidth, pixelHeight);
+
+    RleBitmap bitmap(pixelWidth, pixelHeight);
+    for (int y = 0; y < pixelHeight; ++y)
+    {
+        bool current = false;
+        size_t length = 0;
         for (int x = 0; x < pixelWidth; ++x)
         {
             vec2 glyphPos;
             glyphPos.x = glyph.info().hCursorX + x*glyph.info().width/float(pixelWidth);
             glyphPos.y = glyph.info().hCursorY - y*glyph.info().height/float(pixelHeight);
-            auto inside = glyph.isInside(glyphPos);
-            img.setPixel(x, y, inside*0xffffff);
+            bool inside = glyph.isInside(glyphPos);
+            if (inside != current)
+            {
+                bitmap.append(current ? 0xff : 0, length);
+                current = inside;
+                length = 0;
+            }
+            ++length;
         }
+        bitmap.append(current ? 0xff : 0, length);
+        bitmap.endRow();
     }
-    return img;
+    return bitmap;
 }
@@ -4,11 +4,17 @@
 #include "compressedbitmap.hpp"
 #include "freetype.hpp"
 #include "image.hpp"
+#include "matrix2.hpp"
 #include "primitives.hpp"
+#include "rlebitmap.hpp"
+#include "timer.hpp"
 #include "vector2.hpp"
 
+#include <memory>
 #include <vector>
 
+class OutlineCache;
+
 class Glyph
 {
 public:
@@ -32,33 +38,115 @@ public:
                       // after this glyph has been drawn.
     };
 
-    Glyph(FT_Outline, FT_Glyph_Metrics);
+    // Preprocessed outline data. Glyphs with identical outlines may share a
+    // single instance (see OutlineCache); it is never modified once built.
+    struct Outline
+    {
+        std::vector<PackedBezier> curves;
+        CompressedBitmap bitmap;
+        std::vector<size_t> rowIndices;
+        size_t boxLength;
+
+        // Mixed lookup cells resolve a point from cell-local data only: the
+        // winding contributed by curves wholly left of the cell, height steps
+        // of curves left of it which only partly span its rows, and the curves
+        // reaching into it. cellEntries holds each cell's steps (y << 16 |
+        // delta, adding delta above y) followed by its curve indices.
+        struct Cell
+        {
+            U32 first;
+            U16 steps;
+            U16 curves;
+            S32 winding;
+        };
+        std::vector<U16> cellIndex; // Into cells, for each lookup cell.
+        std::vector<Cell> cells;
+        std::vector<U32> cellEntries;
+
+        // Coarser versions of this outline with their own lookup grids, by
+        // increasing error. Every point of a level's outline lies within
+        // 'error' font units of the full outline and vice versa. Empty unless
+        // the glyph was constructed with levels.
+        struct Level
+        {
+            float error;
+            std::shared_ptr<Outline> outline;
+        };
+        std::vector<Level> levels;
+
+        size_t memoryUsage() const; // In bytes, including all levels.
+    };
+
+    // If a cache is given, the preprocessed outline is shared with any
+    // previously constructed glyph with the same outline. Coarser levels of
+    // detail (see levelOfDetail()) are only built if 'levels' is set.
+    Glyph(FT_Outline, FT_Glyph_Metrics, OutlineCache* cache = nullptr,
+          bool levels = false);
 
     void dumpInfo() const;
 
     const GlyphInfo& info() const { return m_info; }
+    // Time spent processing curves and building the lookup grid; zero if the
+    // outline came from the cache.
+    Timer::Seconds buildTime() const { return m_buildTime; }
+
+    // Returns this glyph using the coarsest level of detail whose error is at
+    // most maxError font units, or the full outline if none is coarse enough
+    // or the glyph was constructed without levels.
+    // The result shares the outline and may be queried like the original.
+    Glyph levelOfDetail(float maxError) const;
+    size_t levelCount() const { return m_outline->levels.size(); }
 
     bool isInside(vec2 pos) const noexcept;
 
-    const CompressedBitmap& getMap() const { return m_bitmap; }
+    // Batch versions of isInside(), writing one byte (0 or 1) or one bit
+    // (LSB-first within each word) per point. Points are resolved from the
+    // lookup grid where possible; the rest are grouped by mixed cell (or by
+    // row band, off the grid), and each curve of a group is tested against all
+    // of the group's points at once.
+    void isInside(const vec2* points, size_t count, U8* out) const;
+    void isInside(const vec2* points, size_t count, U64* bits) const;
+
+    // Returns 0 or 1 if the lookup grid alone shows that isInside() gives
+    // that value for every point in the box [lo, hi], and -1 otherwise.
+    int uniformValue(vec2 lo, vec2 hi) const noexcept;
+
+    struct Crossing
+    {
+        float x;
+        int winding; // +1 or -1, summed over crossings left of a point.
+    };
+
+    // Finds every place where the horizontal line at height y crosses the
+    // outline, sorted by x. The winding number of any number of points on
+    // that line can then be found with a single left-to-right sweep.
+    void rowCrossings(float y, std::vector<Crossing>& crossings) const;
+
+    const CompressedBitmap& getMap() const { return m_outline->bitmap; }
 private:
 
     void extractOutlines(const std::vector<size_t>& contourEnd,
                          const std::vector<ivec2>& position,
-                         const std::vector<bool>& control);
+                         const std::vector<bool>& control,
+                         OutlineCache* cache, bool levels);
     void processCurves(const std::vector<PackedBezier>& curves);
     void createLookup(size_t logLength,
                       const std::vector<PackedBezier>& curves);
+    void createCells();
+    void createLevels(size_t logLength,
+                      const std::vector<PackedBezier>& curves,
+                      const std::vector<size_t>& contourEnd);
+    int cellWinding(size_t x, size_t y, vec2 pos) const noexcept;
 
     void sortByY(std::vector<PackedBezier>& curves);
 
-    std::vector<PackedBezier> m_curves;
+    template <typename Output>
+    void batchInside(const vec2* points, size_t count, Output out) const;
 
-    CompressedBitmap m_bitmap;
-    std::vector<size_t> m_rowindices;
-    size_t m_boxLength;
+    std::shared_ptr<Outline> m_outline;
 
     GlyphInfo m_info;
+    Timer::Seconds m_buildTime;
 };
 
 int intersect(vec2 pos, PackedBezier bezier, float& minusX, float& plusX) noexcept;
@@ -90,5 +178,81 @@ struct FontInfo
 
 Image render(const FontInfo& info, const Glyph& glyph, int width, int height);
 
+// Size in pixels of the image render() produces for the given size arguments.
+ivec2 renderSize(const FontInfo& info, const Glyph& glyph, int width, int height);
+
+// The coarsest level of detail of the glyph whose error is below a quarter of
+// a pixel at the given size. Rendering it instead of the glyph is faster for
+// complex glyphs at small sizes, but may lose details smaller than that; the
+// render functions always use the outline of the glyph they are given. The
+// glyph must have been constructed with levels for this to have any effect.
+Glyph levelForSize(const FontInfo& info, const Glyph& glyph, int width, int height);
+
+// Renders like render(), but into a caller-owned RGBA buffer: pixel (x, y) of
+// the glyph goes to buffer + (originY+y)*stride + 4*(originX+x), with 'stride'
+// in bytes. The buffer must hold renderSize() pixels at that position. Nothing
+// is allocated, so this suits drawing straight into atlases or framebuffers.
+void render(const FontInfo& info, const Glyph& glyph, int width, int height,
+            U8* buffer, size_t stride, size_t originX, size_t originY);
+
+// Renders like render(), but into an image taken from 'pool'. Give it back with
+// ImagePool::release() when done to reuse its storage.
+Image render(const FontInfo& info, const Glyph& glyph, int width, int height,
+             ImagePool& pool);
+
+// Renders the glyph displaced by a fractional pixel offset in [0, 1)^2 (x to
+// the right, y downwards). A nonzero offset component adds one column (row) to
+// the output so that the displaced outline still fits.
+Image render(const FontInfo& info, const Glyph& glyph, int width, int height,
+             vec2 offset);
+
+// Renders the glyph mapped by the affine transform p -> transform*p+translation,
+// where p is a pixel position in the untransformed render() output (y pointing
+// down). Each output pixel is mapped back into glyph space, so the glyph's
+// curves and lookup grid are used unchanged. The image covers the transformed
+// bounding box; its top-left corner lies at 'origin' in transformed space.
+Image render(const FontInfo& info, const Glyph& glyph, int width, int height,
+             const mat2& transform, vec2 translation, ivec2& origin);
+
+// FIR filter applied to the 3x horizontally oversampled coverage when rendering
+// for LCD (RGB stripe) displays. The default weights are those of FreeType's
+// default LCD filter; the weights are normalised by their sum.
+struct LcdFilter
+{
+    LcdFilter() : weights{0x08, 0x4d, 0x56, 0x4d, 0x08}, bgr{false} {}
+    LcdFilter(U32 w0, U32 w1, U32 w2, U32 w3, U32 w4, bool isBgr = false)
+        : weights{w0, w1, w2, w3, w4}, bgr{isBgr} {}
+    U32 weights[5];
+    bool bgr; // Subpixel order is blue, green, red.
+};
+
+// Renders with subpixel precision horizontally, writing the filtered coverage
+// of each subpixel into its own colour channel.
+Image renderLCD(const FontInfo& info, const Glyph& glyph, int width, int height,
+                const LcdFilter& filter = LcdFilter());
+
+// Renders the glyph at each of the given sizes (as the height argument of
+// render()) in a single pass over its rows; sample rows which coincide between
+// sizes share one crossing computation. The result is indexed like 'sizes'.
+std::vector<Image> renderSizes(const FontInfo& info, const Glyph& glyph,
+                               const std::vector<int>& sizes);
+
+// Renders exactly like render(), but splits the image into tiles which are
+// rendered on 'threads' threads (zero meaning one per hardware thread). Tiles
+// which the lookup grid shows to be entirely inside or outside are filled
+// without any per-pixel queries.
+Image renderParallel(const FontInfo& info, const Glyph& glyph,
+                     int width, int height, unsigned threads = 0);
+
+// Renders like render(), but hands the image to 'sink' in strips of at most
+// 'stripHeight' rows, so memory use is bounded by the strip size rather than
+// the full image.
+void renderStrips(const FontInfo& info, const Glyph& glyph,
+                  int width, int height, int stripHeight, StripSink& sink);
+
+// Renders like render(), but emits the coverage directly as runs.
+RleBitmap renderRle(const FontInfo& info, const Glyph& glyph,
+                    int width, int height);
+
 #endif // GLYPH_HPP_INCLUDED
 
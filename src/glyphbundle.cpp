@@ -0,0 +1,234 @@
+#include "glyphbundle.hpp"
+#include "composite.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+const char bundleMagic[4] = {'F', 'G', 'L', 'B'};
+const U32 bundleVersion = 1;
+// Magic, version, glyph count and index capacity.
+const size_t headerSize = 16;
+// Glyph, channels, width, height, offset (two words) and the eight fields of
+// GlyphInfo.
+const size_t entrySize = 4 * 14;
+
+void putU32(U8* out, U32 v)
+{
+    out[0] = U8(v); out[1] = U8(v >> 8); out[2] = U8(v >> 16); out[3] = U8(v >> 24);
+}
+
+U32 getU32(const U8* in)
+{
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((U32)in[3] << 24);
+}
+
+void putInfo(U8* out, const Glyph::GlyphInfo& info)
+{
+    const int fields[] = {info.width, info.height, info.hCursorX, info.hCursorY,
+                          info.xAdvance, info.vCursorX, info.vCursorY,
+                          info.yAdvance};
+    for (int field : fields)
+    {
+        putU32(out, static_cast<U32>(field));
+        out += 4;
+    }
+}
+
+Glyph::GlyphInfo getInfo(const U8* in)
+{
+    int fields[8];
+    for (auto& field : fields)
+    {
+        field = static_cast<S32>(getU32(in));
+        in += 4;
+    }
+    return Glyph::GlyphInfo{fields[0], fields[1], fields[2], fields[3],
+                            fields[4], fields[5], fields[6], fields[7]};
+}
+
+bool isGray(const Image& img)
+{
+    for (size_t i = 0; i < img.p.size(); i += 4)
+    {
+        if (img.p[i] != img.p[i+1] || img.p[i] != img.p[i+2]
+            || img.p[i+3] != 0xff)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // End anonymous namespace
+
+GlyphBundleWriter::GlyphBundleWriter(const std::string& filename, U32 capacity)
+    : m_filename{filename}, m_capacity{capacity},
+      m_offset{headerSize + (U64)capacity * entrySize}, m_finished{false}
+{
+    m_file.open(filename.c_str(), std::ios::binary);
+    if (!m_file.is_open())
+    {
+        throw std::runtime_error("Could not open " + filename + " for writing.");
+    }
+    // Bitmaps go after the index, which is written last.
+    m_file.seekp(m_offset);
+}
+
+GlyphBundleWriter::~GlyphBundleWriter()
+{
+    try
+    {
+        if (!m_finished) finish();
+    }
+    catch (const std::exception&)
+    {
+    }
+}
+
+void GlyphBundleWriter::add(U32 glyph, const Image& img,
+                            const Glyph::GlyphInfo& info)
+{
+    if (m_index.size() == m_capacity)
+    {
+        throw std::runtime_error(m_filename + " is full.");
+    }
+    if (!m_index.empty() && glyph <= m_index.back().glyph)
+    {
+        throw std::runtime_error("Glyphs must be added to " + m_filename
+                                 + " in increasing order.");
+    }
+    if (img.p.size() != 4*img.width*img.height)
+    {
+        throw std::runtime_error("Image width and/or height is wrong.");
+    }
+
+    U32 channels = isGray(img) ? 1 : 4;
+    const U8* data = img.p.data();
+    size_t bytes = img.p.size();
+    if (channels == 1)
+    {
+        m_pixels.resize(img.width * img.height);
+        for (size_t i = 0; i < m_pixels.size(); ++i) m_pixels[i] = img.p[4*i];
+        data = m_pixels.data();
+        bytes = m_pixels.size();
+    }
+    m_file.write(reinterpret_cast<const char*>(data), bytes);
+    if (!m_file)
+    {
+        throw std::runtime_error("Could not write " + m_filename + ".");
+    }
+    m_index.push_back({glyph, channels, (U32)img.width, (U32)img.height,
+                       m_offset, info});
+    m_offset += bytes;
+}
+
+void GlyphBundleWriter::finish()
+{
+    m_finished = true;
+    std::vector<U8> index(headerSize + m_capacity * entrySize, 0);
+    std::memcpy(index.data(), bundleMagic, 4);
+    putU32(&index[4], bundleVersion);
+    putU32(&index[8], m_index.size());
+    putU32(&index[12], m_capacity);
+    U8* out = &index[headerSize];
+    for (const auto& entry : m_index)
+    {
+        putU32(out, entry.glyph);
+        putU32(out + 4, entry.channels);
+        putU32(out + 8, entry.width);
+        putU32(out + 12, entry.height);
+        putU32(out + 16, U32(entry.offset));
+        putU32(out + 20, U32(entry.offset >> 32));
+        putInfo(out + 24, entry.info);
+        out += entrySize;
+    }
+    m_file.seekp(0);
+    m_file.write(reinterpret_cast<const char*>(index.data()), index.size());
+    m_file.close();
+    if (!m_file)
+    {
+        throw std::runtime_error("Could not write " + m_filename + ".");
+    }
+}
+
+GlyphBundle::GlyphBundle(const std::string& filename)
+    : m_file{filename}, m_count{0}
+{
+    const U8* data = m_file.data();
+    if (m_file.size() < headerSize || std::memcmp(data, bundleMagic, 4) != 0
+        || getU32(data + 4) != bundleVersion)
+    {
+        throw std::runtime_error(filename + " is not a glyph bundle.");
+    }
+    m_count = getU32(data + 8);
+    U32 capacity = getU32(data + 12);
+    if (m_count > capacity
+        || headerSize + (U64)capacity * entrySize > m_file.size())
+    {
+        throw std::runtime_error(filename + " has a truncated index.");
+    }
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        const U8* entry = indexEntry(i);
+        U32 channels = getU32(entry + 4);
+        U64 rowBytes = (U64)channels * getU32(entry + 8);
+        U64 offset = getU32(entry + 16) | (U64)getU32(entry + 20) << 32;
+        if ((channels != 1 && channels != 4) || offset > m_file.size()
+            || (rowBytes
+                && getU32(entry + 12) > (m_file.size() - offset) / rowBytes)
+            || (i && getU32(entry) <= getU32(indexEntry(i-1))))
+        {
+            throw std::runtime_error(filename + " has a bad index entry.");
+        }
+    }
+}
+
+const U8* GlyphBundle::indexEntry(size_t i) const
+{
+    return m_file.data() + headerSize + i * entrySize;
+}
+
+GlyphBundle::Entry GlyphBundle::entry(size_t i) const
+{
+    const U8* in = indexEntry(i);
+    U64 offset = getU32(in + 16) | (U64)getU32(in + 20) << 32;
+    return Entry{getU32(in), getU32(in + 4), getU32(in + 8), getU32(in + 12),
+                 m_file.data() + offset, getInfo(in + 24)};
+}
+
+bool GlyphBundle::find(U32 glyph, Entry& found) const
+{
+    size_t lo = 0, hi = m_count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        U32 id = getU32(indexEntry(mid));
+        if (id == glyph)
+        {
+            found = entry(mid);
+            return true;
+        }
+        if (id < glyph) lo = mid + 1;
+        else hi = mid;
+    }
+    return false;
+}
+
+Image GlyphBundle::image(const Entry& entry)
+{
+    Image img(entry.width, entry.height);
+    if (entry.channels == 1)
+    {
+        blitGray(img, 0, 0, entry.pixels, entry.width, entry.height,
+                 entry.width);
+    }
+    else
+    {
+        std::copy(entry.pixels, entry.pixels + img.p.size(), img.p.begin());
+    }
+    return img;
+}
@@ -0,0 +1,95 @@
+#ifndef GLYPHBUNDLE_HPP_INCLUDED
+#define GLYPHBUNDLE_HPP_INCLUDED
+
+#include "glyph.hpp"
+#include "image.hpp"
+#include "mappedfile.hpp"
+#include "types.hpp"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+// All rendered glyphs of a font in one file, instead of a file per glyph.
+//
+// The file starts with a header and an index with room for a fixed number of
+// glyphs, followed by the bitmaps. The index is sorted by glyph id; each entry
+// holds the glyph's GlyphInfo (untranslated, as FreeType reports it) and the
+// offset and dimensions of its bitmap. Images whose pixels are all opaque gray
+// are stored with one byte per pixel, others as RGBA. Everything is
+// little-endian.
+//
+// Writers append bitmaps sequentially and fill in the index when finished;
+// readers map the file and access glyphs at random.
+
+class GlyphBundleWriter
+{
+public:
+    // Reserves index space for up to 'capacity' glyphs.
+    GlyphBundleWriter(const std::string& filename, U32 capacity);
+    // Finishes the bundle if finish() was not called, ignoring errors.
+    ~GlyphBundleWriter();
+
+    GlyphBundleWriter(const GlyphBundleWriter&) = delete;
+    GlyphBundleWriter& operator=(const GlyphBundleWriter&) = delete;
+
+    // Glyphs must be added in increasing order of id.
+    void add(U32 glyph, const Image& img, const Glyph::GlyphInfo& info);
+    // Writes the index; the bundle is incomplete until this is done.
+    void finish();
+
+    size_t size() const { return m_index.size(); }
+
+private:
+    struct Entry
+    {
+        U32 glyph;
+        U32 channels;
+        U32 width;
+        U32 height;
+        U64 offset;
+        Glyph::GlyphInfo info;
+    };
+
+    std::string m_filename;
+    std::ofstream m_file;
+    U32 m_capacity;
+    U64 m_offset; // Of the next bitmap.
+    std::vector<Entry> m_index;
+    std::vector<U8> m_pixels;
+    bool m_finished;
+};
+
+class GlyphBundle
+{
+public:
+    struct Entry
+    {
+        U32 glyph;
+        U32 channels; // 1 for gray, 4 for RGBA.
+        U32 width;
+        U32 height;
+        const U8* pixels; // Rows of width*channels bytes, inside the mapping.
+        Glyph::GlyphInfo info;
+    };
+
+    // Maps the file and checks that the index and all bitmaps lie within it.
+    GlyphBundle(const std::string& filename);
+
+    size_t size() const { return m_count; }
+    // The i'th glyph in order of id.
+    Entry entry(size_t i) const;
+    // Finds a glyph by binary search of the index.
+    bool find(U32 glyph, Entry& entry) const;
+
+    // The glyph's bitmap as an RGBA image.
+    static Image image(const Entry& entry);
+
+private:
+    const U8* indexEntry(size_t i) const;
+
+    MappedFile m_file;
+    U32 m_count;
+};
+
+#endif // GLYPHBUNDLE_HPP_INCLUDED
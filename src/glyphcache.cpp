@@ -0,0 +1,135 @@
+#include "glyphcache.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+
+bool sameCurves(const std::vector<PackedBezier>& a,
+                const std::vector<PackedBezier>& b)
+{
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (a[i].p0x != b[i].p0x || a[i].p1x != b[i].p1x
+            || a[i].p2x != b[i].p2x || a[i].p0y != b[i].p0y
+            || a[i].p1y != b[i].p1y || a[i].p2y != b[i].p2y)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // End anonymous namespace
+
+// FNV-1a over the curve coordinates and the box dimensions the lookup grid is
+// built from.
+U64 OutlineCache::hash(const std::vector<PackedBezier>& curves,
+                       const Glyph::GlyphInfo& info)
+{
+    U64 h = 0xcbf29ce484222325ull;
+    auto mix = [&h](S32 v)
+    {
+        for (size_t i = 0; i < 4; ++i)
+        {
+            h ^= (v >> (8*i)) & 0xff;
+            h *= 0x100000001b3ull;
+        }
+    };
+    mix(info.width);
+    mix(info.height);
+    mix(info.hCursorX);
+    for (const auto& c : curves)
+    {
+        mix(c.p0x); mix(c.p1x); mix(c.p2x);
+        mix(c.p0y); mix(c.p1y); mix(c.p2y);
+    }
+    return h;
+}
+
+std::shared_ptr<Glyph::Outline>
+OutlineCache::find(const std::vector<PackedBezier>& curves,
+                   const Glyph::GlyphInfo& info, bool levels)
+{
+    auto it = m_entries.find(hash(curves, info));
+    if (it == m_entries.end()) return nullptr;
+    for (const auto& entry : it->second)
+    {
+        if (entry.width == info.width && entry.height == info.height
+            && entry.hCursorX == info.hCursorX && entry.levels == levels
+            && sameCurves(entry.curves, curves))
+        {
+            ++m_sharedGlyphs;
+            m_bytesSaved += entry.outline->memoryUsage();
+            m_timeSaved += entry.buildTime;
+            return entry.outline;
+        }
+    }
+    return nullptr;
+}
+
+void OutlineCache::insert(const std::vector<PackedBezier>& curves,
+                          const Glyph::GlyphInfo& info, bool levels,
+                          std::shared_ptr<Glyph::Outline> outline,
+                          Timer::Seconds buildTime)
+{
+    m_entries[hash(curves, info)].push_back({curves, info.width, info.height,
+                                             info.hCursorX, levels, outline,
+                                             buildTime});
+}
+
+size_t OutlineCache::uniqueOutlines() const
+{
+    size_t count = 0;
+    for (const auto& bucket : m_entries) count += bucket.second.size();
+    return count;
+}
+
+void OutlineCache::report(std::ostream& out) const
+{
+    out << "Outlines: " << uniqueOutlines() << " unique, "
+        << m_sharedGlyphs << " shared; saved " << m_bytesSaved
+        << " bytes and " << m_timeSaved << "s of construction.\n";
+}
+
+SubpixelCache::SubpixelCache(const FontInfo& info, int height,
+                             int xPhases, int yPhases)
+    : m_info{info}, m_height{height},
+      m_xPhases{xPhases}, m_yPhases{yPhases}, m_renders{0}
+{
+    if (xPhases < 1 || yPhases < 1)
+    {
+        throw std::domain_error("Need at least one phase per axis.");
+    }
+}
+
+int SubpixelCache::quantize(float pos, int phases, int& pixel)
+{
+    float base = std::floor(pos);
+    int phase = static_cast<int>(std::floor((pos - base) * phases + 0.5f));
+    pixel = static_cast<int>(base);
+    // Rounding up to the next whole pixel is the same as phase zero there.
+    if (phase >= phases)
+    {
+        phase = 0;
+        ++pixel;
+    }
+    return phase;
+}
+
+const Image& SubpixelCache::get(U32 glyphIndex, const Glyph& glyph,
+                                vec2 position, ivec2& pixelPos)
+{
+    int xPhase = quantize(position.x, m_xPhases, pixelPos.x);
+    int yPhase = quantize(position.y, m_yPhases, pixelPos.y);
+
+    Key key{glyphIndex, xPhase, yPhase};
+    auto it = m_variants.find(key);
+    if (it != m_variants.end()) return it->second;
+
+    vec2 offset{xPhase / float(m_xPhases), yPhase / float(m_yPhases)};
+    ++m_renders;
+    return m_variants[key] = render(m_info, glyph, 0, m_height, offset);
+}
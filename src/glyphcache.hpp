@@ -0,0 +1,102 @@
+#ifndef GLYPHCACHE_HPP_INCLUDED
+#define GLYPHCACHE_HPP_INCLUDED
+
+#include "glyph.hpp"
+#include "image.hpp"
+#include "timer.hpp"
+#include "vector2.hpp"
+
+#include <map>
+#include <memory>
+#include <ostream>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// Shares preprocessed outlines between glyphs whose normalised (translated)
+// curve sets and bounding boxes are identical, e.g. duplicate code points or
+// composite glyphs that reduce to the same outline. Outlines are found by a
+// content hash and verified by comparing the curves. Outlines built with and
+// without levels of detail are kept apart.
+class OutlineCache
+{
+public:
+    OutlineCache() : m_sharedGlyphs{0}, m_bytesSaved{0}, m_timeSaved{0} {}
+
+    // Returns the outline built for an identical curve set with the same
+    // choice of levels, or null if there is none yet.
+    std::shared_ptr<Glyph::Outline>
+    find(const std::vector<PackedBezier>& curves, const Glyph::GlyphInfo& info,
+         bool levels);
+
+    // Registers a freshly built outline together with the time it took to
+    // build, which is credited as saved on every later hit.
+    void insert(const std::vector<PackedBezier>& curves,
+                const Glyph::GlyphInfo& info, bool levels,
+                std::shared_ptr<Glyph::Outline> outline,
+                Timer::Seconds buildTime);
+
+    size_t uniqueOutlines() const;
+    size_t sharedGlyphs() const { return m_sharedGlyphs; }
+    size_t bytesSaved() const { return m_bytesSaved; }
+    Timer::Seconds timeSaved() const { return m_timeSaved; }
+
+    void report(std::ostream& out) const;
+
+private:
+    struct Entry
+    {
+        std::vector<PackedBezier> curves;
+        int width;
+        int height;
+        int hCursorX;
+        bool levels;
+        std::shared_ptr<Glyph::Outline> outline;
+        Timer::Seconds buildTime;
+    };
+
+    static U64 hash(const std::vector<PackedBezier>& curves,
+                    const Glyph::GlyphInfo& info);
+
+    std::unordered_map<U64, std::vector<Entry>> m_entries;
+    size_t m_sharedGlyphs;
+    size_t m_bytesSaved;
+    Timer::Seconds m_timeSaved;
+};
+
+// Caches subpixel-positioned renders of glyphs at a single size. Fractional pen
+// positions are quantized to a fixed number of phases per axis, so each glyph
+// is rendered at most xPhases*yPhases times regardless of how often (and where)
+// it is placed.
+class SubpixelCache
+{
+public:
+    SubpixelCache(const FontInfo& info, int height,
+                  int xPhases = 4, int yPhases = 1);
+
+    // Returns the variant to draw for a glyph whose unshifted render would
+    // have its top-left corner at the (fractional) pixel position 'position'.
+    // The top-left corner of the returned image should be placed at
+    // 'pixelPos'. The glyph index is only used as a cache key.
+    const Image& get(U32 glyphIndex, const Glyph& glyph, vec2 position,
+                     ivec2& pixelPos);
+
+    void clear() { m_variants.clear(); }
+
+    size_t size() const { return m_variants.size(); }
+    size_t renders() const { return m_renders; }
+
+private:
+    static int quantize(float pos, int phases, int& pixel);
+
+    using Key = std::tuple<U32, int, int>;
+    std::map<Key, Image> m_variants;
+
+    FontInfo m_info;
+    int m_height;
+    int m_xPhases;
+    int m_yPhases;
+    size_t m_renders;
+};
+
+#endif // GLYPHCACHE_HPP_INCLUDED
@@ -0,0 +1,125 @@
+#include "glyphclient.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+
+// Receives the hello message and the ring descriptor attached to it.
+bool receiveHello(int socket, GlyphHello& hello, int& ringFd)
+{
+    iovec data{&hello, sizeof(hello)};
+    char control[CMSG_SPACE(sizeof(int))];
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    if (recvmsg(socket, &message, MSG_WAITALL) != (ssize_t)sizeof(hello))
+    {
+        return false;
+    }
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if (!header || header->cmsg_level != SOL_SOCKET
+        || header->cmsg_type != SCM_RIGHTS)
+    {
+        return false;
+    }
+    std::memcpy(&ringFd, CMSG_DATA(header), sizeof(int));
+    return true;
+}
+
+const char* statusMessage(S32 status)
+{
+    switch (status)
+    {
+    case glyphBadRequest: return "Bad glyph request.";
+    case glyphFontError: return "Glyph server could not load the font.";
+    case glyphEmpty: return "Glyph is empty.";
+    case glyphTooLarge: return "Glyph bitmap does not fit the ring.";
+    default: return "Unknown glyph server error.";
+    }
+}
+
+} // End anonymous namespace
+
+GlyphClient::GlyphClient(const std::string& socketPath)
+    : m_socket{-1}, m_ring{nullptr}, m_ringSize{0}
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        throw std::runtime_error("Socket path too long: " + socketPath);
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_socket < 0)
+    {
+        throw std::runtime_error("Could not create socket.");
+    }
+    GlyphHello hello;
+    int ringFd = -1;
+    if (connect(m_socket, (const sockaddr*)&address, sizeof(address)) != 0
+        || !receiveHello(m_socket, hello, ringFd))
+    {
+        close(m_socket);
+        throw std::runtime_error("Could not connect to glyph server at "
+                                 + socketPath + ".");
+    }
+    void* ring = mmap(nullptr, hello.ringSize, PROT_READ, MAP_SHARED,
+                      ringFd, 0);
+    close(ringFd);
+    if (hello.version != glyphProtocolVersion || ring == MAP_FAILED)
+    {
+        if (ring != MAP_FAILED) munmap(ring, hello.ringSize);
+        close(m_socket);
+        throw std::runtime_error("Incompatible glyph server.");
+    }
+    m_ring = static_cast<const U8*>(ring);
+    m_ringSize = hello.ringSize;
+}
+
+GlyphClient::~GlyphClient()
+{
+    munmap(const_cast<U8*>(m_ring), m_ringSize);
+    close(m_socket);
+}
+
+GlyphClient::Bitmap GlyphClient::renderView(const std::string& font,
+                                            U32 glyphIndex,
+                                            int width, int height)
+{
+    GlyphRequest request{glyphIndex, width, height, (U32)font.size()};
+    GlyphReply reply;
+    if (!sendAll(m_socket, &request, sizeof(request))
+        || !sendAll(m_socket, font.data(), font.size())
+        || !receiveAll(m_socket, &reply, sizeof(reply)))
+    {
+        throw std::runtime_error("Lost connection to glyph server.");
+    }
+    if (reply.status != glyphOk)
+    {
+        throw std::runtime_error(statusMessage(reply.status));
+    }
+    return Bitmap{m_ring + reply.offset, reply.width, reply.height};
+}
+
+Image GlyphClient::render(const std::string& font, U32 glyphIndex,
+                          int width, int height)
+{
+    Bitmap bitmap = renderView(font, glyphIndex, width, height);
+    Image img(bitmap.width, bitmap.height);
+    std::memcpy(img.p.data(), bitmap.pixels, img.p.size());
+    return img;
+}
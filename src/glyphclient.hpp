@@ -0,0 +1,46 @@
+#ifndef GLYPHCLIENT_HPP_INCLUDED
+#define GLYPHCLIENT_HPP_INCLUDED
+
+#include "glyphprotocol.hpp"
+#include "image.hpp"
+
+#include <string>
+
+// Connection to a GlyphServer. Fonts are named by their path relative to the
+// server's font directory.
+class GlyphClient
+{
+public:
+    // Pixels laid out as Image::p, pointing into memory shared with the
+    // server. They stay valid until later requests on this client have used
+    // up the ring, i.e. for at least ringSize() minus the bitmap's size bytes.
+    struct Bitmap
+    {
+        const U8* pixels;
+        size_t width;
+        size_t height;
+    };
+
+    GlyphClient(const std::string& socketPath);
+    ~GlyphClient();
+
+    GlyphClient(const GlyphClient&) = delete;
+    GlyphClient& operator=(const GlyphClient&) = delete;
+
+    // Renders exactly as render(info, glyph, width, height) would on the
+    // glyph with the given index, without copying the pixels.
+    Bitmap renderView(const std::string& font, U32 glyphIndex,
+                      int width, int height);
+    // As renderView(), copied into an Image.
+    Image render(const std::string& font, U32 glyphIndex,
+                 int width, int height);
+
+    size_t ringSize() const { return m_ringSize; }
+
+private:
+    int m_socket;
+    const U8* m_ring;
+    size_t m_ringSize;
+};
+
+#endif // GLYPHCLIENT_HPP_INCLUDED
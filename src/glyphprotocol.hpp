@@ -0,0 +1,54 @@
+#ifndef GLYPHPROTOCOL_HPP_INCLUDED
+#define GLYPHPROTOCOL_HPP_INCLUDED
+
+#include "types.hpp"
+
+#include <string>
+
+// Wire format between GlyphServer and GlyphClient over a Unix stream socket.
+// Both ends run on the same host, so structs are sent in native layout.
+//
+// On connecting, the server sends a GlyphHello with the file descriptor of a
+// shared-memory ring private to the connection attached (SCM_RIGHTS). Each
+// GlyphRequest (followed by fontLength bytes of font path, relative to the
+// server's font directory) is answered by a GlyphReply; on success the RGBA
+// pixels, laid out as in Image, are in the ring at the given offset.
+
+const U32 glyphProtocolVersion = 1;
+
+enum GlyphStatus : S32
+{
+    glyphOk = 0,
+    glyphBadRequest,
+    glyphFontError,
+    glyphEmpty,
+    glyphTooLarge,
+};
+
+struct GlyphHello
+{
+    U32 version;
+    U64 ringSize;
+};
+
+struct GlyphRequest
+{
+    U32 glyphIndex;
+    S32 width; // As the size arguments of render().
+    S32 height;
+    U32 fontLength;
+};
+
+struct GlyphReply
+{
+    S32 status;
+    U32 width;
+    U32 height;
+    U64 offset;
+};
+
+// Sends or receives exactly 'size' bytes; false if the peer went away.
+bool sendAll(int fd, const void* data, size_t size);
+bool receiveAll(int fd, void* data, size_t size);
+
+#endif // GLYPHPROTOCOL_HPP_INCLUDED
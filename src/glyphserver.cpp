@@ -0,0 +1,423 @@
+#include "glyphserver.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+
+// Longest font path accepted in a request.
+const U32 maxFontLength = 1024;
+// Largest size argument of render() accepted in a request.
+const S32 maxPixelSize = 2048;
+
+// Puts a font name from a client into one canonical form, so that "a.ttf"
+// and "./a.ttf" share a font and its bitmaps, and checks that it stays inside
+// the font directory: it must be relative and have no '..' component. Links
+// in the directory are followed, as whoever runs the server put them there.
+bool normaliseFontName(const std::string& name, std::string& normal)
+{
+    normal.clear();
+    if (name.empty() || name[0] == '/' || name.find('\0') != std::string::npos)
+    {
+        return false;
+    }
+    for (size_t begin = 0; begin <= name.size();)
+    {
+        size_t end = std::min(name.find('/', begin), name.size());
+        std::string part = name.substr(begin, end - begin);
+        if (part == "..") return false;
+        if (!part.empty() && part != ".")
+        {
+            if (!normal.empty()) normal += '/';
+            normal += part;
+        }
+        begin = end + 1;
+    }
+    return !normal.empty();
+}
+
+bool setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+sockaddr_un socketAddress(const std::string& path)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        throw std::runtime_error("Socket path too long: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+// Creates an unnamed shared-memory object of the given size.
+int createRing(size_t size)
+{
+    std::string name = "/glyphring." + std::to_string(getpid());
+    int fd = -1;
+    for (int attempt = 0; fd < 0 && attempt < 100; ++attempt)
+    {
+        std::string unique = name + "." + std::to_string(attempt);
+        fd = shm_open(unique.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd >= 0) shm_unlink(unique.c_str());
+        else if (errno != EEXIST) break;
+    }
+    if (fd < 0 || ftruncate(fd, size) != 0)
+    {
+        if (fd >= 0) close(fd);
+        throw std::runtime_error("Could not create shared memory ring.");
+    }
+    return fd;
+}
+
+// Sends the hello message with the ring's descriptor attached.
+bool sendHello(int socket, int ringFd, size_t ringSize)
+{
+    GlyphHello hello{glyphProtocolVersion, ringSize};
+    iovec data{&hello, sizeof(hello)};
+    char control[CMSG_SPACE(sizeof(int))];
+    std::memset(control, 0, sizeof(control));
+
+    msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(header), &ringFd, sizeof(int));
+
+    return sendmsg(socket, &message, MSG_NOSIGNAL) == (ssize_t)sizeof(hello);
+}
+
+} // End anonymous namespace
+
+GlyphServer::GlyphServer(const std::string& socketPath,
+                         const std::string& fontDirectory, size_t ringSize,
+                         size_t bitmapCacheSize)
+    : m_socketPath{socketPath}, m_fontDirectory{fontDirectory},
+      m_ringSize{ringSize}, m_bitmapCacheSize{bitmapCacheSize},
+      m_bitmapBytes{0}, m_listener{-1}, m_running{false}
+{
+    struct stat info;
+    if (stat(fontDirectory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode))
+    {
+        throw std::runtime_error("Font directory not found: " + fontDirectory);
+    }
+    if (m_fontDirectory.back() != '/') m_fontDirectory += '/';
+    checkFTError(FT_Init_FreeType(&m_library));
+
+    sockaddr_un address = socketAddress(socketPath);
+    m_listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listener < 0)
+    {
+        FT_Done_FreeType(m_library);
+        throw std::runtime_error("Could not create socket.");
+    }
+    unlink(socketPath.c_str());
+    if (bind(m_listener, (const sockaddr*)&address, sizeof(address)) != 0
+        || listen(m_listener, 64) != 0 || !setNonBlocking(m_listener))
+    {
+        close(m_listener);
+        FT_Done_FreeType(m_library);
+        throw std::runtime_error("Could not listen on " + socketPath + ".");
+    }
+}
+
+GlyphServer::~GlyphServer()
+{
+    for (auto& client : m_clients) disconnect(client);
+    close(m_listener);
+    unlink(m_socketPath.c_str());
+    // Faces must go before the library they belong to.
+    m_fonts.clear();
+    FT_Done_FreeType(m_library);
+}
+
+void GlyphServer::run()
+{
+    m_running = true;
+    std::vector<pollfd> fds;
+    while (m_running)
+    {
+        fds.assign(1, pollfd{m_listener, POLLIN, 0});
+        // Clients are not read from until their replies are sent.
+        for (const auto& client : m_clients)
+        {
+            short events = client.output.empty() ? POLLIN : POLLOUT;
+            fds.push_back(pollfd{client.fd, events, 0});
+        }
+        // Wake up now and then to notice stop().
+        int ready = poll(fds.data(), fds.size(), 100);
+        if (ready < 0 && errno != EINTR)
+        {
+            throw std::runtime_error("poll() failed.");
+        }
+        if (ready <= 0) continue;
+
+        // Serve existing clients before accepting, as accepting changes
+        // m_clients.
+        for (size_t i = fds.size() - 1; i > 0; --i)
+        {
+            if (!fds[i].revents) continue;
+            Client& client = m_clients[i-1];
+            bool alive = (fds[i].revents & POLLOUT) ? flush(client)
+                                                    : receive(client);
+            if (!alive || !serve(client) || !flush(client))
+            {
+                disconnect(m_clients[i-1]);
+                m_clients.erase(m_clients.begin() + (i-1));
+            }
+        }
+        if (fds[0].revents & POLLIN) accept();
+    }
+}
+
+void GlyphServer::accept()
+{
+    int fd = ::accept(m_listener, nullptr, nullptr);
+    if (fd < 0) return;
+
+    int ringFd = -1;
+    void* ring = MAP_FAILED;
+    try
+    {
+        ringFd = createRing(m_ringSize);
+        ring = mmap(nullptr, m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    ringFd, 0);
+    }
+    catch (const std::runtime_error&) {}
+    if (ring == MAP_FAILED || !sendHello(fd, ringFd, m_ringSize))
+    {
+        if (ring != MAP_FAILED) munmap(ring, m_ringSize);
+        if (ringFd >= 0) close(ringFd);
+        close(fd);
+        return;
+    }
+    // The client holds its own reference to the memory now.
+    close(ringFd);
+    if (!setNonBlocking(fd))
+    {
+        munmap(ring, m_ringSize);
+        close(fd);
+        return;
+    }
+    m_clients.push_back(Client{fd, static_cast<U8*>(ring), 0, {}, {}});
+}
+
+void GlyphServer::disconnect(Client& client)
+{
+    munmap(client.ring, m_ringSize);
+    close(client.fd);
+}
+
+bool GlyphServer::receive(Client& client)
+{
+    U8 buffer[4096];
+    // Once a request of the largest size fits, the rest waits in the socket.
+    while (client.input.size() < sizeof(GlyphRequest) + maxFontLength)
+    {
+        ssize_t received = recv(client.fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+        if (received == 0) return false;
+        client.input.insert(client.input.end(), buffer, buffer + received);
+    }
+    return true;
+}
+
+bool GlyphServer::serve(Client& client)
+{
+    // Only complete requests are handled; the rest stays buffered.
+    size_t used = 0;
+    while (client.input.size() - used >= sizeof(GlyphRequest))
+    {
+        GlyphRequest request;
+        std::memcpy(&request, &client.input[used], sizeof(request));
+        if (request.fontLength > maxFontLength) return false;
+        size_t length = sizeof(request) + request.fontLength;
+        if (client.input.size() - used < length) break;
+        const char* path = reinterpret_cast<const char*>(&client.input[used])
+                         + sizeof(request);
+        reply(client, request, std::string(path, request.fontLength));
+        used += length;
+    }
+    client.input.erase(client.input.begin(), client.input.begin() + used);
+    return true;
+}
+
+bool GlyphServer::flush(Client& client)
+{
+    size_t sent = 0;
+    while (sent < client.output.size())
+    {
+        ssize_t count = send(client.fd, &client.output[sent],
+                             client.output.size() - sent, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (count <= 0) return false;
+        sent += count;
+    }
+    client.output.erase(client.output.begin(), client.output.begin() + sent);
+    return true;
+}
+
+void GlyphServer::reply(Client& client, const GlyphRequest& request,
+                        const std::string& path)
+{
+    GlyphReply reply{glyphOk, 0, 0, 0};
+    GlyphStatus status = glyphOk;
+    Image scratch;
+    const Image* img = bitmap(request, path, scratch, status);
+    if (img)
+    {
+        if (img->p.size() > m_ringSize)
+        {
+            status = glyphTooLarge;
+        }
+        else
+        {
+            if (client.next + img->p.size() > m_ringSize) client.next = 0;
+            std::memcpy(client.ring + client.next, img->p.data(),
+                        img->p.size());
+            reply.width = img->width;
+            reply.height = img->height;
+            reply.offset = client.next;
+            // Keep bitmaps word aligned.
+            client.next += (img->p.size() + 15) & ~size_t(15);
+        }
+    }
+    reply.status = status;
+    const U8* bytes = reinterpret_cast<const U8*>(&reply);
+    client.output.insert(client.output.end(), bytes, bytes + sizeof(reply));
+}
+
+GlyphServer::Font* GlyphServer::font(const std::string& name)
+{
+    auto it = m_fonts.find(name);
+    if (it != m_fonts.end()) return it->second.get();
+
+    std::unique_ptr<Font> font(new Font);
+    try
+    {
+        font->face.reset(new FontFace(FontFile::open(m_fontDirectory + name),
+                                      m_library));
+        font->info.reset(new FontInfo(font->face->face()));
+    }
+    catch (const std::runtime_error&)
+    {
+        return nullptr;
+    }
+    return (m_fonts[name] = std::move(font)).get();
+}
+
+const Image* GlyphServer::bitmap(const GlyphRequest& request,
+                                 const std::string& path, Image& scratch,
+                                 GlyphStatus& status)
+{
+    std::string name;
+    if (!normaliseFontName(path, name))
+    {
+        status = glyphFontError;
+        return nullptr;
+    }
+    BitmapKey key{name, request.glyphIndex, request.width, request.height};
+    auto cached = m_bitmaps.find(key);
+    if (cached != m_bitmaps.end())
+    {
+        m_bitmapUses.splice(m_bitmapUses.begin(), m_bitmapUses,
+                            cached->second.use);
+        return &cached->second.image;
+    }
+
+    Font* f = font(name);
+    if (!f)
+    {
+        status = glyphFontError;
+        return nullptr;
+    }
+    FT_Face face = f->face->face();
+    if (request.glyphIndex >= (U32)face->num_glyphs
+        || (request.width <= 0 && request.height <= 0)
+        || request.width > maxPixelSize || request.height > maxPixelSize)
+    {
+        status = glyphBadRequest;
+        return nullptr;
+    }
+
+    auto it = f->glyphs.find(request.glyphIndex);
+    if (it == f->glyphs.end())
+    {
+        if (FT_Load_Glyph(face, request.glyphIndex, FT_LOAD_NO_SCALE))
+        {
+            status = glyphFontError;
+            return nullptr;
+        }
+        std::unique_ptr<Glyph> glyph;
+        try
+        {
+            glyph.reset(new Glyph(face->glyph->outline, face->glyph->metrics,
+                                  &f->outlines));
+        }
+        catch (const std::runtime_error&) {} // Empty glyphs stay null.
+        it = f->glyphs.emplace(request.glyphIndex, std::move(glyph)).first;
+    }
+    if (!it->second)
+    {
+        status = glyphEmpty;
+        return nullptr;
+    }
+
+    // Bitmaps too large for the ring are refused before rendering them.
+    ivec2 size = renderSize(*f->info, *it->second, request.width,
+                            request.height);
+    if (4 * (size_t)size.x * (size_t)size.y > m_ringSize)
+    {
+        status = glyphTooLarge;
+        return nullptr;
+    }
+
+    try
+    {
+        scratch = render(*f->info, *it->second, request.width, request.height);
+    }
+    catch (const std::exception&)
+    {
+        status = glyphBadRequest;
+        return nullptr;
+    }
+    if (scratch.p.size() > m_bitmapCacheSize) return &scratch;
+    while (m_bitmapBytes + scratch.p.size() > m_bitmapCacheSize)
+    {
+        auto oldest = m_bitmaps.find(m_bitmapUses.back());
+        m_bitmapBytes -= oldest->second.image.p.size();
+        m_bitmaps.erase(oldest);
+        m_bitmapUses.pop_back();
+    }
+    m_bitmapBytes += scratch.p.size();
+    m_bitmapUses.push_front(key);
+    CachedBitmap& entry = m_bitmaps[key];
+    entry.image = std::move(scratch);
+    entry.use = m_bitmapUses.begin();
+    return &entry.image;
+}
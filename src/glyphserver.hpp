@@ -0,0 +1,96 @@
+#ifndef GLYPHSERVER_HPP_INCLUDED
+#define GLYPHSERVER_HPP_INCLUDED
+
+#include "fontfile.hpp"
+#include "glyph.hpp"
+#include "glyphcache.hpp"
+#include "glyphprotocol.hpp"
+#include "image.hpp"
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Per-host daemon keeping fonts, preprocessed glyphs and rendered bitmaps
+// resident for any number of client processes (see GlyphClient). Requests
+// arrive over a Unix domain socket; pixels are returned through a shared
+// memory ring per connection, so clients never copy them through the socket.
+// Sockets are non-blocking, so a slow or stalled client holds up no others.
+class GlyphServer
+{
+public:
+    // Clients name fonts by paths relative to 'fontDirectory'; nothing outside
+    // it is opened. 'ringSize' bytes of shared memory are mapped per client; it
+    // bounds the largest bitmap that can be served. Rendered bitmaps are kept
+    // up to 'bitmapCacheSize' bytes, dropping the least recently used ones.
+    GlyphServer(const std::string& socketPath, const std::string& fontDirectory,
+                size_t ringSize = 16 << 20, size_t bitmapCacheSize = 256 << 20);
+    ~GlyphServer();
+
+    GlyphServer(const GlyphServer&) = delete;
+    GlyphServer& operator=(const GlyphServer&) = delete;
+
+    // Serves clients until stop() is called (e.g. from a signal handler).
+    void run();
+    void stop() { m_running = false; }
+
+private:
+    struct Font
+    {
+        std::unique_ptr<FontFace> face;
+        std::unique_ptr<FontInfo> info;
+        OutlineCache outlines;
+        // Null for glyphs without an outline.
+        std::map<U32, std::unique_ptr<Glyph>> glyphs;
+    };
+
+    struct Client
+    {
+        int fd;
+        U8* ring;
+        size_t next; // Where the next bitmap is written.
+        std::vector<U8> input; // Received bytes not yet handled.
+        std::vector<U8> output; // Replies not yet sent.
+    };
+
+    using BitmapKey = std::tuple<std::string, U32, S32, S32>;
+
+    struct CachedBitmap
+    {
+        Image image;
+        std::list<BitmapKey>::iterator use; // Position in m_bitmapUses.
+    };
+
+    void accept();
+    // These return false if the client is to be disconnected.
+    bool receive(Client& client);
+    bool serve(Client& client);
+    bool flush(Client& client);
+    void reply(Client& client, const GlyphRequest& request,
+               const std::string& path);
+    void disconnect(Client& client);
+    // 'name' must be normalised (see bitmap()).
+    Font* font(const std::string& name);
+    const Image* bitmap(const GlyphRequest& request, const std::string& path,
+                        Image& scratch, GlyphStatus& status);
+
+    std::string m_socketPath;
+    std::string m_fontDirectory; // With a trailing slash.
+    size_t m_ringSize;
+    size_t m_bitmapCacheSize;
+    size_t m_bitmapBytes;
+    int m_listener;
+    FT_Library m_library;
+    std::atomic<bool> m_running;
+
+    std::vector<Client> m_clients;
+    std::map<std::string, std::unique_ptr<Font>> m_fonts;
+    std::map<BitmapKey, CachedBitmap> m_bitmaps;
+    std::list<BitmapKey> m_bitmapUses; // Most recently used first.
+};
+
+#endif // GLYPHSERVER_HPP_INCLUDED
@@ -0,0 +1,178 @@
+#include "glyphstore.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+struct GlyphStore::Worker
+{
+    Worker()
+    {
+        checkFTError(FT_Init_FreeType(&library));
+    }
+    ~Worker()
+    {
+        // Faces must go before the library they belong to.
+        faces.clear();
+        FT_Done_FreeType(library);
+    }
+
+    FT_Library library;
+    std::map<const FontFile*, std::unique_ptr<FontFace>> faces;
+};
+
+GlyphStore::GlyphStore(unsigned threads, size_t capacity)
+    : m_capacity{std::max<size_t>(1, capacity)}, m_pending{0},
+      m_stopping{false}
+{
+    if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < threads; ++i)
+    {
+        m_threads.emplace_back(&GlyphStore::work, this);
+    }
+}
+
+GlyphStore::~GlyphStore()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto& thread : m_threads) thread.join();
+
+    // Whoever still waits for a queued glyph gets told why it never came.
+    for (auto& task : m_tasks)
+    {
+        task.promise->set_exception(std::make_exception_ptr(
+            std::runtime_error("Glyph store destroyed before the glyph was "
+                               "built.")));
+    }
+}
+
+void GlyphStore::prefetch(std::shared_ptr<const FontFile> font,
+                          const std::vector<U32>& codepoints, int size)
+{
+    for (U32 codepoint : codepoints) request(font, codepoint, size);
+}
+
+std::shared_future<GlyphStore::EntryPtr>
+GlyphStore::request(std::shared_ptr<const FontFile> font, U32 codepoint,
+                    int size)
+{
+    if (size <= 0)
+    {
+        throw std::domain_error("Glyph size must be positive.");
+    }
+    Key key{font.get(), codepoint, size};
+    std::shared_future<EntryPtr> future;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(key);
+        if (it != m_entries.end())
+        {
+            m_uses.splice(m_uses.begin(), m_uses, it->second.use);
+            return it->second.future;
+        }
+
+        auto promise = std::make_shared<std::promise<EntryPtr>>();
+        future = promise->get_future().share();
+        m_uses.push_front(key);
+        m_entries[key] = Cached{future, m_uses.begin()};
+        FontRef& ref = m_fonts[font.get()];
+        ref.font = font;
+        ++ref.entries;
+        ++m_pending;
+        m_tasks.push_back(Task{promise, std::move(font), codepoint, size});
+        evict();
+    }
+    m_wake.notify_one();
+    return future;
+}
+
+GlyphStore::EntryPtr
+GlyphStore::find(const std::shared_ptr<const FontFile>& font, U32 codepoint,
+                 int size) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(Key{font.get(), codepoint, size});
+    if (it == m_entries.end()
+        || it->second.future.wait_for(std::chrono::seconds(0))
+           != std::future_status::ready)
+    {
+        return nullptr;
+    }
+    m_uses.splice(m_uses.begin(), m_uses, it->second.use);
+    try
+    {
+        return it->second.future.get();
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+size_t GlyphStore::pending() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending;
+}
+
+void GlyphStore::work()
+{
+    Worker worker;
+    while (true)
+    {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+            if (m_stopping) return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        try
+        {
+            task.promise->set_value(build(worker, task.font, task.codepoint,
+                                          task.size));
+        }
+        catch (...)
+        {
+            task.promise->set_exception(std::current_exception());
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_pending;
+    }
+}
+
+void GlyphStore::evict()
+{
+    while (m_entries.size() > m_capacity)
+    {
+        // An evicted task still runs; only its result is not kept.
+        const Key& key = m_uses.back();
+        auto font = m_fonts.find(std::get<0>(key));
+        if (!--font->second.entries) m_fonts.erase(font);
+        m_entries.erase(key);
+        m_uses.pop_back();
+    }
+}
+
+GlyphStore::EntryPtr
+GlyphStore::build(Worker& worker, const std::shared_ptr<const FontFile>& font,
+                  U32 codepoint, int size)
+{
+    auto& face = worker.faces[font.get()];
+    if (!face) face.reset(new FontFace(font, worker.library));
+
+    std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+    entry->glyphIndex = FT_Get_Char_Index(face->face(), codepoint);
+    checkFTError(FT_Load_Glyph(face->face(), entry->glyphIndex,
+                               FT_LOAD_NO_SCALE));
+    FT_GlyphSlot slot = face->face()->glyph;
+    if (!slot->outline.n_contours || !slot->outline.n_points) return entry;
+
+    entry->glyph = std::make_shared<const Glyph>(slot->outline, slot->metrics);
+    entry->image = render(FontInfo(face->face()), *entry->glyph, 0, size);
+    return entry;
+}
@@ -0,0 +1,114 @@
+#ifndef GLYPHSTORE_HPP_INCLUDED
+#define GLYPHSTORE_HPP_INCLUDED
+
+#include "fontfile.hpp"
+#include "glyph.hpp"
+#include "image.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+// Thread-safe cache of constructed glyphs and their renders, filled by a pool
+// of background threads. Callers that know which text comes next prefetch()
+// it, so that drawing only ever picks up finished results. Every (font, code
+// point, size) is built once while it stays cached: concurrent requests share
+// one in-flight task, and the least recently used entries are dropped once
+// there are more than 'capacity'.
+class GlyphStore
+{
+public:
+    struct Entry
+    {
+        U32 glyphIndex;
+        std::shared_ptr<const Glyph> glyph; // Null if the glyph is empty.
+        Image image; // render(info, *glyph, 0, size); empty if glyph is.
+    };
+    using EntryPtr = std::shared_ptr<const Entry>;
+
+    // 'threads' zero means one per hardware thread. Glyphs still queued when
+    // the store is destroyed are not built; their futures throw instead.
+    GlyphStore(unsigned threads = 0, size_t capacity = 4096);
+    ~GlyphStore();
+
+    GlyphStore(const GlyphStore&) = delete;
+    GlyphStore& operator=(const GlyphStore&) = delete;
+
+    // Schedules the given code points of 'font' at pixel height 'size' and
+    // returns immediately.
+    void prefetch(std::shared_ptr<const FontFile> font,
+                  const std::vector<U32>& codepoints, int size);
+
+    // Future for a single glyph, scheduling it unless already known. Errors
+    // while building it (other than the glyph being empty) are rethrown by
+    // the future.
+    std::shared_future<EntryPtr> request(std::shared_ptr<const FontFile> font,
+                                         U32 codepoint, int size);
+
+    // The finished entry, or null if it is not (yet) available. Never blocks.
+    EntryPtr find(const std::shared_ptr<const FontFile>& font, U32 codepoint,
+                  int size) const;
+
+    // Waits for the entry, scheduling it first if needed.
+    EntryPtr get(std::shared_ptr<const FontFile> font, U32 codepoint, int size)
+    {
+        return request(std::move(font), codepoint, size).get();
+    }
+
+    // Number of scheduled glyphs that have not finished yet.
+    size_t pending() const;
+
+private:
+    // Per-thread FreeType state; faces are not shared between threads.
+    struct Worker;
+
+    using Key = std::tuple<const FontFile*, U32, int>;
+
+    struct Task
+    {
+        std::shared_ptr<std::promise<EntryPtr>> promise;
+        std::shared_ptr<const FontFile> font;
+        U32 codepoint;
+        int size;
+    };
+
+    struct Cached
+    {
+        std::shared_future<EntryPtr> future;
+        std::list<Key>::iterator use; // Position in m_uses.
+    };
+
+    // Keeps a font alive while entries refer to it, so that its address is
+    // not reused as a key.
+    struct FontRef
+    {
+        std::shared_ptr<const FontFile> font;
+        size_t entries;
+    };
+
+    void work();
+    EntryPtr build(Worker& worker, const std::shared_ptr<const FontFile>& font,
+                   U32 codepoint, int size);
+    // Drops least recently used entries beyond the capacity; needs m_mutex.
+    void evict();
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<Task> m_tasks;
+    std::map<Key, Cached> m_entries;
+    mutable std::list<Key> m_uses; // Most recently used first.
+    std::map<const FontFile*, FontRef> m_fonts;
+    size_t m_capacity;
+    size_t m_pending;
+    bool m_stopping;
+    std::vector<std::thread> m_threads;
+};
+
+#endif // GLYPHSTORE_HPP_INCLUDED
@@ -48,3 +48,87 @@ void writeImage(const Image& img)
     int res = system(("compresspnm "+fname+' '+fname.substr(0, fname.size() - 4)+".png").c_str());
     (void)res;
 }
+
+Image ImagePool::acquire(size_t width, size_t height, std::string name)
+{
+    Image img;
+    img.name = std::move(name);
+    img.width = width;
+    img.height = height;
+    size_t bytes = 4 * width * height;
+    if (!m_free.empty())
+    {
+        // Prefer the smallest buffer that is large enough; failing that, grow
+        // the largest one.
+        size_t best = 0;
+        for (size_t i = 1; i < m_free.size(); ++i)
+        {
+            size_t cap = m_free[i].capacity();
+            size_t bestCap = m_free[best].capacity();
+            bool fits = cap >= bytes;
+            bool bestFits = bestCap >= bytes;
+            if (fits != bestFits ? fits : (fits ? cap < bestCap : cap > bestCap))
+            {
+                best = i;
+            }
+        }
+        img.p.swap(m_free[best]);
+        m_free[best].swap(m_free.back());
+        m_free.pop_back();
+    }
+    img.p.resize(bytes);
+    return img;
+}
+
+void ImagePool::release(Image&& img)
+{
+    m_free.push_back(std::move(img.p));
+    img.p.clear();
+    img.width = img.height = 0;
+}
+
+PnmStripWriter::PnmStripWriter(std::string filename)
+    : m_filename{filename}, m_nextRow{0}
+{
+    m_file.open(m_filename.c_str(), std::ios::binary);
+    if (!m_file.is_open())
+    {
+        throw std::runtime_error("Could not open " + m_filename
+                                 + " for writing.");
+    }
+}
+
+void PnmStripWriter::begin(size_t width, size_t height)
+{
+    writePnmHeader(m_file, width, height);
+    m_row.resize(3*width);
+}
+
+void PnmStripWriter::write(const Image& strip, size_t firstRow)
+{
+    if (firstRow != m_nextRow || 3*strip.width != m_row.size())
+    {
+        throw std::runtime_error("Strip does not continue " + m_filename + ".");
+    }
+    for (size_t y = 0; y < strip.height; ++y)
+    {
+        const U8* src = &strip.p[4*strip.width*y];
+        for (size_t x = 0; x < strip.width; ++x)
+        {
+            m_row[3*x] = src[4*x];
+            m_row[3*x+1] = src[4*x+1];
+            m_row[3*x+2] = src[4*x+2];
+        }
+        m_file.write(reinterpret_cast<const char*>(m_row.data()), m_row.size());
+    }
+    m_nextRow += strip.height;
+}
+
+void PnmStripWriter::end()
+{
+    m_file.close();
+    if (!m_file)
+    {
+        throw std::runtime_error("Could not write " + m_filename + ".");
+    }
+}
@@ -2,6 +2,7 @@
 #define IMAGE_HPP_INCLUDED
 
 #include "types.hpp"
+#include <fstream>
 #include <string>
 #include <vector>
 
@@ -47,6 +48,10 @@ struct Image
         }
     }
 
+    // First byte of row y; pixels follow as RGBA.
+    U8* row(size_t y) { return &p[4*width*y]; }
+    const U8* row(size_t y) const { return &p[4*width*y]; }
+
     inline Colour pixel(size_t x, size_t y) const
     {
         return {p[4*width*y+4*x  ], p[4*width*y+4*x+1],
@@ -79,5 +84,53 @@ inline bool operator!=(const Image& a, const Image& b)
 
 void writeImage(const Image& img);
 
+// Recycles image storage, so that code producing many short-lived images does
+// not allocate once the pool has warmed up. Not thread-safe; use one pool per
+// thread.
+class ImagePool
+{
+public:
+    // The pixel contents of the returned image are unspecified.
+    Image acquire(size_t width, size_t height, std::string name = "");
+    // Returns the image's storage to the pool.
+    void release(Image&& img);
+
+    size_t available() const { return m_free.size(); }
+
+private:
+    std::vector<std::vector<U8>> m_free;
+};
+
+// Receives an image as a sequence of horizontal strips, top to bottom, so that
+// the whole image never needs to be in memory at once.
+class StripSink
+{
+public:
+    virtual ~StripSink() = default;
+    // Called once with the dimensions of the full image before any strips.
+    virtual void begin(size_t width, size_t height) = 0;
+    // The strip covers rows [firstRow, firstRow + strip.height).
+    virtual void write(const Image& strip, size_t firstRow) = 0;
+    // Called once after the last strip.
+    virtual void end() {}
+};
+
+// Writes the strips to a binary PNM file as they arrive.
+class PnmStripWriter : public StripSink
+{
+public:
+    PnmStripWriter(std::string filename);
+
+    void begin(size_t width, size_t height) override;
+    void write(const Image& strip, size_t firstRow) override;
+    void end() override;
+
+private:
+    std::string m_filename;
+    std::ofstream m_file;
+    std::vector<U8> m_row;
+    size_t m_nextRow;
+};
+
 #endif // IMAGE_HPP_INCLUDED
 
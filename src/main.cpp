@@ -1,47 +1,112 @@
+#include "benchmark.hpp"
 #include "common.hpp"
+#include "checksums.hpp"
 #include "crc.hpp"
+#include "fontfile.hpp"
 #include "freetype.hpp"
 #include "glyph.hpp"
+#include "glyphbundle.hpp"
+#include "glyphcache.hpp"
+#include "glyphserver.hpp"
 #include "image.hpp"
 #include "primitives.hpp"
-#include "timer.hpp"
+#include "profiler.hpp"
 
+#include <csignal>
 #include <iostream>
-#include <fstream>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <vector>
 
-std::map<int, U32> readChecksums(std::string fontname)
+namespace
 {
-    std::map<int, U32> checksums;
-    std::ifstream input((fontname + ".crc32").c_str());
-    if (!input.is_open()) return checksums;
-    while (input.good())
-    {
-        int glyph;
-        U32 sum;
-        input >> glyph >> sum;
-        checksums[glyph] = sum;
+
+// Parses "i/N" with i < N.
+void parseShard(const std::string& arg, U32& shard, U32& shardCount)
+{
+    std::istringstream in(arg);
+    char slash = 0;
+    if (!(in >> shard >> slash >> shardCount) || slash != '/'
+        || !shardCount || shard >= shardCount || !in.eof())
+    {
+        throw std::domain_error("Bad shard '" + arg + "'; expected i/N.");
     }
-    return checksums;
 }
 
-bool writeChecksums(std::string fontname, std::map<int, U32> checksums)
+std::vector<std::string> splitList(const std::string& list)
 {
-    std::ofstream output((fontname + ".crc32").c_str());
-    if (!output.is_open()) return false;
-    for (auto& sum : checksums)
+    std::vector<std::string> items;
+    std::istringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ',')) if (!item.empty()) items.push_back(item);
+    return items;
+}
+
+// Merge mode: combines the shard files of a font and compares the result to
+// its golden checksums, which are replaced if 'update' is set.
+int mergeShards(const std::string& fontname,
+                const std::vector<std::string>& files, bool update)
+{
+    ShardHeader header;
+    Checksums merged = mergeChecksumShards(files, header);
+    if (header.face != fontname)
+    {
+        throw std::runtime_error("Shards are of font '" + header.face
+                                 + "', not '" + fontname + "'.");
+    }
+    // The goldens hold one pixel per font unit; other sizes cannot match.
+    if (header.pixelSize)
+    {
+        throw std::runtime_error("Shards were rendered at "
+                                 + std::to_string(header.pixelSize)
+                                 + " px; goldens need the default size.");
+    }
+    Checksums golden = readChecksums(fontname + ".crc32");
+    ChecksumDiff diff = diffChecksums(golden, merged);
+
+    auto list = [](const char* what, const std::vector<int>& glyphs)
+    {
+        if (glyphs.empty()) return;
+        std::cerr << what << " (" << glyphs.size() << "):";
+        for (int glyph : glyphs) std::cerr << ' ' << glyph;
+        std::cerr << '\n';
+    };
+    std::cerr << "Merged " << merged.size() << " checksums of font '"
+              << fontname << "' from " << files.size() << " shards.\n";
+    list("BAD", diff.mismatched);
+    list("Missing", diff.missing);
+    list("Unvalidated", diff.unexpected);
+
+    if (update && !writeChecksums(fontname + ".crc32", merged))
     {
-        output << sum.first << ' ' << sum.second << '\n';
+        std::cerr << "Could not write " << fontname << ".crc32.\n";
+        return 1;
     }
-    return true;
+    return diff.empty() || update ? 0 : 1;
 }
 
-int main()
+GlyphServer* runningServer = nullptr;
+
+void stopServer(int)
 {
-    FT_Library ftLib;
-    checkFTError(FT_Init_FreeType(&ftLib));
+    if (runningServer) runningServer->stop();
+}
+
+} // End anonymous namespace
+
+int main(int argc, char** argv)
+{
+    // Daemon mode: font --serve <socket path> [font directory]
+    if ((argc == 3 || argc == 4) && std::string(argv[1]) == "--serve")
+    {
+        GlyphServer server(argv[2], argc == 4 ? argv[3] : "fonts");
+        runningServer = &server;
+        std::signal(SIGINT, stopServer);
+        std::signal(SIGTERM, stopServer);
+        server.run();
+        return 0;
+    }
 
     std::vector<std::string> faces
     {
@@ -49,48 +114,180 @@ int main()
     };
 
     bool validate = true;
-    bool writeImages = false;
+    bool writeImages = false; // As one bundle file per font.
+    bool writePnm = false; // As one .pnm (and .png) file per glyph.
     bool updateChecksums = false;
+    // Compare speed and output with FreeType's rasterizer instead.
+    bool benchmark = false;
+    int size = 0; // Pixel height of the em square; zero for one pixel per unit.
+    U32 shard = 0;
+    U32 shardCount = 1;
+    bool sharded = false; // Any --shard, even 0/1, writes a shard file.
+    std::vector<std::string> mergeFiles;
+
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--faces" && hasValue) faces = splitList(argv[++i]);
+            else if (arg == "--size" && hasValue) size = std::stoi(argv[++i]);
+            else if (arg == "--shard" && hasValue)
+            {
+                parseShard(argv[++i], shard, shardCount);
+                sharded = true;
+            }
+            else if (arg == "--write-images") writeImages = true;
+            else if (arg == "--write-pnm") writePnm = true;
+            else if (arg == "--update") updateChecksums = true;
+            else if (arg == "--no-validate") validate = false;
+            else if (arg == "--benchmark") benchmark = true;
+            else if (arg == "--merge")
+            {
+                mergeFiles.assign(argv + i + 1, argv + argc);
+                break;
+            }
+            else throw std::domain_error("Unknown argument '" + arg + "'.");
+        }
+        if (size < 0) throw std::domain_error("--size must not be negative.");
+        // Goldens are rendered at one pixel per font unit.
+        if (size && updateChecksums)
+        {
+            throw std::domain_error("--update cannot be used with --size.");
+        }
+        if (!mergeFiles.empty())
+        {
+            if (faces.size() != 1)
+            {
+                throw std::domain_error("--merge needs exactly one face.");
+            }
+            return mergeShards(faces[0], mergeFiles, updateChecksums);
+        }
+    }
+    catch (const std::runtime_error& err)
+    {
+        std::cerr << err.what() << "\n";
+        return 1;
+    }
+    catch (const std::exception& err)
+    {
+        std::cerr << err.what() << "\n"
+                  << "Usage: font [--faces a,b,...] [--size px] [--shard i/N]"
+                  << " [--write-images] [--write-pnm] [--update]"
+                  << " [--no-validate]\n"
+                  << "       font [--faces a,b,...] [--size px] --benchmark\n"
+                  << "       font --faces name [--update] --merge shard files\n"
+                  << "       font --serve socket [font directory]\n";
+        return 2;
+    }
+    // A shard writes its own partial file; goldens are updated on merging.
+    if (sharded) updateChecksums = false;
+    if (size) validate = false;
+
+    FT_Library ftLib;
+    checkFTError(FT_Init_FreeType(&ftLib));
+
+    if (benchmark)
+    {
+        for (auto& fontname : faces)
+        {
+            FontFace fontFace(FontFile::open("fonts/" + fontname + ".ttf"),
+                              ftLib);
+            reportBenchmark(std::cerr,
+                            benchmarkFace(fontFace.face(), fontname, size));
+        }
+        checkFTError(FT_Done_FreeType(ftLib));
+        return 0;
+    }
 
     for (auto& fontname : faces)
     {
-    FT_Face face;
-    checkFTError(FT_New_Face(ftLib,
-                             ("fonts/" + fontname + ".ttf").c_str(),
-                             0,
-                             &face));
+    auto file = FontFile::open("fonts/" + fontname + ".ttf");
+    FontFace fontFace(file, ftLib);
+    FT_Face face = fontFace.face();
     checkFTError(FT_Set_Pixel_Sizes(face, 0, 64));
 
-    std::map<int, U32> checksums = readChecksums(fontname);
+    Checksums checksums = readChecksums(fontname + ".crc32");
+    Checksums results;
+    OutlineCache outlines;
+
+    Glyph::GlyphInfo metrics;
+
+    std::unique_ptr<GlyphBundleWriter> bundle;
+    if (writeImages)
+    {
+        std::string bundleName = "output/" + fontname;
+        if (sharded)
+        {
+            bundleName += ".shard-" + std::to_string(shard) + "-of-"
+                        + std::to_string(shardCount);
+        }
+        U32 glyphs = (face->num_glyphs - shard + shardCount - 1) / shardCount;
+        bundle.reset(new GlyphBundleWriter(bundleName + ".glyphs", glyphs));
+    }
 
     std::cerr << "Rendering font '" << fontname << "' [";
-    std::cerr << face->num_glyphs << " glyphs].\n";
+    std::cerr << face->num_glyphs << " glyphs";
+    if (sharded) std::cerr << ", shard " << shard << "/" << shardCount;
+    std::cerr << "].\n";
 
-    Timer timer;
-    timer.start();
-    for (int idx = 0; idx < face->num_glyphs; ++idx)
+    Profiler profiler;
+    ImagePool images;
+    // Shards take every shardCount-th glyph rather than a contiguous range,
+    // since complex glyphs tend to be clustered.
+    for (int idx = shard; idx < face->num_glyphs; idx += shardCount)
     {
+        Profiler::Scope glyphScope(profiler, Profiler::Total, idx);
         std::stringstream name;
         name << idx;
         std::cerr << "Rendering glyph #" << name.str() << "...";
-        checkFTError(FT_Load_Glyph(face, idx, FT_LOAD_NO_SCALE));
-        FT_GlyphSlot slot = face->glyph;
         try
         {
             U32 checksum;
-            Glyph glyph(slot->outline, slot->metrics);
+            std::unique_ptr<Glyph> loaded;
+            {
+                Profiler::Scope scope(profiler, Profiler::Construct, idx);
+                checkFTError(FT_Load_Glyph(face, idx, FT_LOAD_NO_SCALE));
+                FT_GlyphSlot slot = face->glyph;
+                loaded.reset(new Glyph(slot->outline, slot->metrics,
+                                       &outlines));
+                const auto& m = slot->metrics;
+                metrics = Glyph::GlyphInfo{
+                    (int)m.width, (int)m.height,
+                    (int)m.horiBearingX, (int)m.horiBearingY,
+                    (int)m.horiAdvance, (int)m.vertBearingX,
+                    (int)m.vertBearingY, (int)m.vertAdvance};
+            }
+            const Glyph& glyph = *loaded;
+            if (glyph.buildTime() > 0)
+            {
+                profiler.record(Profiler::Lookup, idx,
+                                static_cast<U64>(glyph.buildTime() * 1e9));
+            }
             FontInfo info(face);
-            Image img = render(info, glyph, 0, info.emSize);
+            Image img;
+            {
+                Profiler::Scope scope(profiler, Profiler::Render, idx);
+                img = render(info, glyph, 0, size ? size : info.emSize, images);
+            }
             img.name = "output/" + fontname + "_" + name.str() + ".pnm";
 
-            if (writeImages)
+            if (writeImages || writePnm)
             {
-                writeImage(img);
+                Profiler::Scope scope(profiler, Profiler::Write, idx);
+                if (bundle) bundle->add(idx, img, metrics);
+                if (writePnm) writeImage(img);
             }
 
-            if (validate)
+            if (validate || updateChecksums || sharded)
             {
+                Profiler::Scope scope(profiler, Profiler::Checksum, idx);
                 checksum = crc(img.p.data(), img.p.size());
+                results[idx] = checksum;
+            }
+            if (validate)
+            {
                 if (checksums.find(idx) == checksums.end())
                 {
                     std::cerr << " done, but unvalidated!\n";
@@ -106,11 +303,7 @@ int main()
             {
                 std::cerr << " done!\n";
             }
-            if (updateChecksums)
-            {
-                if (!validate) checksum = crc(img.p.data(), img.p.size());
-                checksums[idx] = checksum;
-            }
+            images.release(std::move(img));
 
         }
         catch (const std::runtime_error& err)
@@ -118,14 +311,21 @@ int main()
             std::cerr << " FAILED: " << err.what() << "\n";
         }
     }
-    timer.stop();
-    std::cerr << "Total time: " << timer.duration() << "\n";
-
-    checkFTError(FT_Done_Face(face));
+    if (bundle) bundle->finish();
+    profiler.report(std::cerr);
+    outlines.report(std::cerr);
 
+    if (sharded)
+    {
+        writeChecksumShard(shardFilename(fontname, shard, shardCount),
+                           ShardHeader{fontname, static_cast<U32>(size),
+                                       shard, shardCount},
+                           results);
+    }
     if (updateChecksums)
     {
-        writeChecksums(fontname, checksums);
+        for (auto& sum : results) checksums[sum.first] = sum.second;
+        writeChecksums(fontname + ".crc32", checksums);
     }
 
     }
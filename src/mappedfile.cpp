@@ -0,0 +1,37 @@
+#include "mappedfile.hpp"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path)
+    : m_path{path}, m_data{nullptr}, m_size{0}
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Could not open " + path + ".");
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+        close(fd);
+        throw std::runtime_error("Could not stat " + path + ".");
+    }
+    m_size = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("Could not map " + path + ".");
+    }
+    m_data = static_cast<const U8*>(mapping);
+}
+
+MappedFile::~MappedFile()
+{
+    munmap(const_cast<U8*>(m_data), m_size);
+}
@@ -25,4 +25,9 @@ void PackedBezier::construct()
     /// cgz, kgz
     lookup |= 0x40*((bgz ? agz : 1) && (mgz ? 0 : !agz));
     lookup |= 0x80*((bgz ? 0 : !agz) && (mgz ? agz : 1));
+
+    // Control point on the chord, between the end points.
+    S64 cross = (S64)(p1x-p0x)*(p2y-p0y) - (S64)(p1y-p0y)*(p2x-p0x);
+    S64 dot = (S64)(p1x-p0x)*(p2x-p1x) + (S64)(p1y-p0y)*(p2y-p1y);
+    lookup |= lineBit*(cross == 0 && dot >= 0 && p0y != p2y);
 }
@@ -56,6 +56,10 @@ struct PackedBezier
         return PackedBezier(ivec2{p0y, p0x}, ivec2{p1y, p1x}, ivec2{p2y, p2x});
     }
 
+    // Set in lookup if the curve is a straight, non-horizontal line from p0 to
+    // p2. intersect() then finds the crossing without the quadratic formula.
+    static const U32 lineBit = 0x100;
+
     U32 lookup;
     T p0x;
     T p1x;
@@ -0,0 +1,145 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+namespace
+{
+
+const int subBucketBits = 5;
+const U64 subBucketCount = U64(1) << subBucketBits;
+
+// Index of the highest set bit; value must be non-zero.
+int highestBit(U64 value)
+{
+#ifdef __GNUC__
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1) ++bit;
+    return bit;
+#endif
+}
+
+const char* stageName(Profiler::Stage stage)
+{
+    switch (stage)
+    {
+    case Profiler::Construct: return "construct";
+    case Profiler::Lookup: return "lookup";
+    case Profiler::Render: return "render";
+    case Profiler::Checksum: return "checksum";
+    case Profiler::Write: return "write";
+    case Profiler::Total: return "total";
+    case Profiler::StageCount:
+    default: return "?";
+    }
+}
+
+// Formats nanoseconds with a unit that keeps the number short.
+std::string duration(U64 ns)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    if (ns < 10000) out << ns << "ns";
+    else if (ns < 10000000) out << ns / 1e3 << "us";
+    else if (ns < 10000000000ull) out << ns / 1e6 << "ms";
+    else out << ns / 1e9 << "s";
+    return out.str();
+}
+
+} // End anonymous namespace
+
+LatencyHistogram::LatencyHistogram()
+    : m_counts((64 - subBucketBits + 1) * subBucketCount)
+{
+    clear();
+}
+
+size_t LatencyHistogram::bucket(U64 value)
+{
+    if (value < subBucketCount) return value;
+    int shift = highestBit(value) - subBucketBits;
+    return (shift + 1) * subBucketCount + (value >> shift) - subBucketCount;
+}
+
+U64 LatencyHistogram::bucketMax(size_t index)
+{
+    if (index < subBucketCount) return index;
+    size_t shift = index / subBucketCount - 1;
+    U64 sub = index % subBucketCount + subBucketCount;
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(U64 nanoseconds, U32 tag)
+{
+    ++m_counts[bucket(nanoseconds)];
+    ++m_count;
+    m_total += nanoseconds;
+    m_max = std::max(m_max, nanoseconds);
+
+    if (m_slowest.size() < slowestKept
+        || nanoseconds > m_slowest.back().nanoseconds)
+    {
+        if (m_slowest.size() == slowestKept) m_slowest.pop_back();
+        auto pos = std::find_if(m_slowest.begin(), m_slowest.end(),
+                                [nanoseconds](const Sample& s)
+                                { return s.nanoseconds < nanoseconds; });
+        m_slowest.insert(pos, Sample{nanoseconds, tag});
+    }
+}
+
+void LatencyHistogram::clear()
+{
+    std::fill(m_counts.begin(), m_counts.end(), 0);
+    m_slowest.clear();
+    m_count = 0;
+    m_total = 0;
+    m_max = 0;
+}
+
+U64 LatencyHistogram::percentile(double p) const
+{
+    if (!m_count) return 0;
+    U64 wanted = static_cast<U64>(p / 100. * m_count + .5);
+    wanted = std::min(std::max<U64>(wanted, 1), m_count);
+    U64 seen = 0;
+    for (size_t i = 0; i < m_counts.size(); ++i)
+    {
+        seen += m_counts[i];
+        if (seen >= wanted) return std::min(bucketMax(i), m_max);
+    }
+    return m_max;
+}
+
+void Profiler::clear()
+{
+    for (auto& stage : m_stages) stage.clear();
+}
+
+void Profiler::report(std::ostream& out) const
+{
+    out << std::left << std::setw(10) << "stage" << std::right
+        << std::setw(8) << "count" << std::setw(10) << "total"
+        << std::setw(10) << "p50" << std::setw(10) << "p99"
+        << std::setw(10) << "max" << "  slowest glyphs\n";
+    for (int i = 0; i < StageCount; ++i)
+    {
+        const auto& h = m_stages[i];
+        if (!h.count()) continue;
+        out << std::left << std::setw(10) << stageName(Stage(i)) << std::right
+            << std::setw(8) << h.count()
+            << std::setw(10) << duration(h.total())
+            << std::setw(10) << duration(h.percentile(50))
+            << std::setw(10) << duration(h.percentile(99))
+            << std::setw(10) << duration(h.max()) << " ";
+        for (const auto& sample : h.slowest())
+        {
+            out << " #" << sample.tag << " (" << duration(sample.nanoseconds)
+                << ")";
+        }
+        out << "\n";
+    }
+}
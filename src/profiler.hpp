@@ -0,0 +1,111 @@
+#ifndef PROFILER_HPP_INCLUDED
+#define PROFILER_HPP_INCLUDED
+
+#include "types.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// Latency histogram in the spirit of HdrHistogram: values are bucketed by
+// power of two and then linearly into 32 sub-buckets, so any value is kept to
+// within ~3% using fixed memory and constant time per sample. The slowest
+// samples are also kept together with a caller supplied tag (a glyph index).
+class LatencyHistogram
+{
+public:
+    struct Sample
+    {
+        U64 nanoseconds;
+        U32 tag;
+    };
+
+    LatencyHistogram();
+
+    void record(U64 nanoseconds, U32 tag);
+    void clear();
+
+    U64 count() const { return m_count; }
+    U64 total() const { return m_total; }
+    U64 max() const { return m_max; }
+    // Smallest recorded bucket bound at or above the given percentile (0-100).
+    U64 percentile(double p) const;
+    // Slowest samples, slowest first.
+    const std::vector<Sample>& slowest() const { return m_slowest; }
+
+    static const size_t slowestKept = 5;
+
+private:
+    static size_t bucket(U64 value);
+    static U64 bucketMax(size_t index);
+
+    std::vector<U64> m_counts;
+    std::vector<Sample> m_slowest;
+    U64 m_count;
+    U64 m_total;
+    U64 m_max;
+};
+
+// Records per-glyph latencies of each rendering stage.
+class Profiler
+{
+public:
+    enum Stage
+    {
+        Construct, // Whole Glyph construction, including Lookup.
+        Lookup,    // Curve processing and lookup grid creation.
+        Render,
+        Checksum,
+        Write,
+        Total,     // Everything done for one glyph.
+        StageCount
+    };
+
+    // Times its own lifetime.
+    class Scope
+    {
+    public:
+        Scope(Profiler& profiler, Stage stage, U32 glyph)
+            : m_profiler(profiler), m_stage{stage}, m_glyph{glyph},
+              m_start{Clock::now()} {}
+        ~Scope()
+        {
+            auto duration = Clock::now() - m_start;
+            m_profiler.record(m_stage, m_glyph, std::chrono::duration_cast
+                              <std::chrono::nanoseconds>(duration).count());
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Profiler& m_profiler;
+        Stage m_stage;
+        U32 m_glyph;
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    Profiler() : m_stages(StageCount) {}
+
+    void record(Stage stage, U32 glyph, U64 nanoseconds)
+    {
+        m_stages[stage].record(nanoseconds, glyph);
+    }
+    void clear();
+
+    const LatencyHistogram& histogram(Stage stage) const
+    {
+        return m_stages[stage];
+    }
+
+    // Prints count, total, p50, p99 and max per stage, followed by the
+    // slowest glyphs. Stages without samples are left out.
+    void report(std::ostream& out) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<LatencyHistogram> m_stages;
+};
+
+#endif // PROFILER_HPP_INCLUDED
@@ -0,0 +1,116 @@
+#include "rlebitmap.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+RleBitmap::RleBitmap(size_t width, size_t height)
+    : m_width{width}, m_height{0}
+{
+    m_rowStart.reserve(height+1);
+    m_rowStart.push_back(0);
+}
+
+void RleBitmap::append(U8 value, size_t length)
+{
+    size_t rowBegin = m_rowStart.back();
+    if (length && m_runs.size() > rowBegin && m_runs.back().value == value)
+    {
+        size_t room = 0xffff - m_runs.back().length;
+        size_t merged = std::min(room, length);
+        m_runs.back().length += merged;
+        length -= merged;
+    }
+    while (length)
+    {
+        size_t part = std::min<size_t>(length, 0xffff);
+        m_runs.push_back({(U16)part, value});
+        length -= part;
+    }
+}
+
+void RleBitmap::endRow()
+{
+    m_rowStart.push_back(m_runs.size());
+    ++m_height;
+}
+
+size_t RleBitmap::memoryUsage() const
+{
+    return sizeof(RleBitmap)
+         + m_runs.capacity() * sizeof(Run)
+         + m_rowStart.capacity() * sizeof(U32);
+}
+
+U8 RleBitmap::value(size_t x, size_t y) const
+{
+    for (const Run* run = rowBegin(y); run != rowEnd(y); ++run)
+    {
+        if (x < run->length) return run->value;
+        x -= run->length;
+    }
+    throw std::out_of_range("RleBitmap position out of range.");
+}
+
+// Calls fill(pixel, count, value) for each clipped run, where 'pixel' is the
+// first byte of the run in dst.
+template <typename Fill>
+void RleBitmap::forEachRun(const Image& dst, int x, int y, Fill fill) const
+{
+    int rowFirst = std::max(0, -y);
+    int rowLast = std::min<int>(m_height, (int)dst.height - y);
+    for (int row = rowFirst; row < rowLast; ++row)
+    {
+        size_t rowOffset = 4 * dst.width * (row + y);
+        int start = x;
+        for (const Run* run = rowBegin(row); run != rowEnd(row); ++run)
+        {
+            int begin = std::max(start, 0);
+            int end = std::min(start + (int)run->length, (int)dst.width);
+            start += run->length;
+            if (begin < end)
+            {
+                fill(rowOffset + 4 * begin, (size_t)(end - begin), run->value);
+            }
+        }
+    }
+}
+
+void RleBitmap::decode(Image& dst, int x, int y) const
+{
+    forEachRun(dst, x, y, [&dst](size_t pos, size_t count, U8 v)
+    {
+        U8* pixel = &dst.p[pos];
+        if (v == 0xff)
+        {
+            std::memset(pixel, 0xff, 4 * count);
+            return;
+        }
+        const U8 grey[4] = {v, v, v, 0xff};
+        for (size_t i = 0; i < count; ++i) std::memcpy(pixel + 4*i, grey, 4);
+    });
+}
+
+void RleBitmap::composite(Image& dst, int x, int y, Colour colour) const
+{
+    const U8 solid[4] = {colour.r, colour.g, colour.b, colour.a};
+    forEachRun(dst, x, y, [&](size_t pos, size_t count, U8 v)
+    {
+        U32 alpha = (v * colour.a + 127) / 255;
+        if (!alpha) return;
+        U8* pixel = &dst.p[pos];
+        if (alpha == 255)
+        {
+            for (size_t i = 0; i < count; ++i) std::memcpy(pixel + 4*i, solid, 4);
+            return;
+        }
+        for (size_t i = 0; i < 4*count; i += 4)
+        {
+            for (size_t c = 0; c < 3; ++c)
+            {
+                pixel[i+c] = (solid[c] * alpha + pixel[i+c] * (255 - alpha) + 127) / 255;
+            }
+            pixel[i+3] = alpha + (pixel[i+3] * (255 - alpha) + 127) / 255;
+        }
+    });
+}
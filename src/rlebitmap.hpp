@@ -0,0 +1,56 @@
+#ifndef RLEBITMAP_HPP_INCLUDED
+#define RLEBITMAP_HPP_INCLUDED
+
+#include "image.hpp"
+#include "types.hpp"
+
+#include <vector>
+
+// Run-length encoded 8-bit coverage mask. Rendered glyphs consist mostly of
+// long runs of empty or full coverage, so this takes a fraction of the memory
+// of an Image, and drawing it can fill whole runs at once.
+class RleBitmap
+{
+public:
+    struct Run
+    {
+        U16 length;
+        U8 value;
+    };
+
+    RleBitmap() : m_width{0}, m_height{0} {}
+    RleBitmap(size_t width, size_t height);
+
+    // Rows are built top to bottom; appended runs go into the current row,
+    // which is finished by endRow().
+    void append(U8 value, size_t length);
+    void endRow();
+
+    size_t width() const { return m_width; }
+    size_t height() const { return m_height; }
+    size_t memoryUsage() const; // In bytes.
+
+    const Run* rowBegin(size_t y) const { return m_runs.data() + m_rowStart[y]; }
+    const Run* rowEnd(size_t y) const { return m_runs.data() + m_rowStart[y+1]; }
+
+    U8 value(size_t x, size_t y) const;
+
+    // Writes the mask as opaque gray pixels with its top-left corner at (x, y)
+    // in dst, clipped to dst.
+    void decode(Image& dst, int x, int y) const;
+
+    // Blends 'colour' over dst using the mask (scaled by colour.a) as alpha,
+    // with the mask's top-left corner at (x, y), clipped to dst.
+    void composite(Image& dst, int x, int y, Colour colour) const;
+
+private:
+    template <typename Fill>
+    void forEachRun(const Image& dst, int x, int y, Fill fill) const;
+
+    size_t m_width;
+    size_t m_height;
+    std::vector<Run> m_runs;
+    std::vector<U32> m_rowStart; // Index of each row's first run, plus end.
+};
+
+#endif // RLEBITMAP_HPP_INCLUDED
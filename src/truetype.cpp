@@ -0,0 +1,227 @@
+#include "truetype.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+// Composite glyph component flags.
+const U16 argsAreWords = 0x0001;
+const U16 haveScale = 0x0008;
+const U16 moreComponents = 0x0020;
+const U16 haveXYScale = 0x0040;
+const U16 haveTwoByTwo = 0x0080;
+const U16 useMyMetrics = 0x0200;
+
+const int maxCompositeDepth = 16;
+
+void need(const U8* p, size_t n, const U8* end)
+{
+    if (p > end || (size_t)(end - p) < n)
+    {
+        throw std::runtime_error("Truncated TrueType data.");
+    }
+}
+
+U16 readU16(const U8*& p, const U8* end)
+{
+    need(p, 2, end);
+    U16 v = (p[0] << 8) | p[1];
+    p += 2;
+    return v;
+}
+
+S16 readS16(const U8*& p, const U8* end)
+{
+    return static_cast<S16>(readU16(p, end));
+}
+
+U32 readU32(const U8*& p, const U8* end)
+{
+    need(p, 4, end);
+    U32 v = ((U32)p[0] << 24) | ((U32)p[1] << 16) | ((U32)p[2] << 8) | p[3];
+    p += 4;
+    return v;
+}
+
+} // End anonymous namespace
+
+TrueTypeFont::TrueTypeFont(const U8* data, size_t size)
+    : m_data{data}, m_size{size}
+{
+    size_t length;
+    const U8* head = table("head", length);
+    const U8* end = head + length;
+    const U8* p = head + 18;
+    m_emSize = readU16(p, end);
+    p = head + 50;
+    m_longLoca = readS16(p, end) != 0;
+
+    const U8* maxp = table("maxp", length);
+    p = maxp + 4;
+    m_glyphCount = readU16(p, maxp + length);
+
+    const U8* hhea = table("hhea", length);
+    end = hhea + length;
+    p = hhea + 4;
+    int ascender = readS16(p, end);
+    int descender = readS16(p, end);
+    p = hhea + 34;
+    m_hMetricCount = readU16(p, end);
+
+    // Without vertical metrics FreeType spaces lines by the typographic
+    // ascender and descender, falling back to the horizontal header's.
+    const U8* os2 = findTable("OS/2", length);
+    if (os2)
+    {
+        end = os2 + length;
+        p = os2 + 68;
+        ascender = readS16(p, end);
+        descender = readS16(p, end);
+    }
+    m_verticalAdvance = std::abs(ascender - descender);
+
+    m_hmtx = table("hmtx", m_hmtxLength);
+    m_loca = table("loca", m_locaLength);
+    m_glyf = table("glyf", m_glyfLength);
+}
+
+const U8* TrueTypeFont::findTable(const char* tag, size_t& length) const
+{
+    const U8* end = m_data + m_size;
+    const U8* p = m_data + 4;
+    U16 tableCount = readU16(p, end);
+    p = m_data + 12;
+    for (U16 i = 0; i < tableCount; ++i)
+    {
+        const U8* record = p;
+        p += 4;
+        readU32(p, end); // Checksum.
+        U32 offset = readU32(p, end);
+        U32 tableLength = readU32(p, end);
+        need(record, 4, end);
+        if (std::memcmp(record, tag, 4) == 0)
+        {
+            need(m_data + offset, tableLength, end);
+            length = tableLength;
+            return m_data + offset;
+        }
+    }
+    return nullptr;
+}
+
+const U8* TrueTypeFont::table(const char* tag, size_t& length) const
+{
+    const U8* data = findTable(tag, length);
+    if (data) return data;
+    throw std::runtime_error(std::string("TrueType table '") + tag
+                             + "' missing.");
+}
+
+int TrueTypeFont::advance(U32 index) const
+{
+    if (!m_hMetricCount) return 0;
+    U32 entry = std::min<U32>(index, m_hMetricCount - 1);
+    const U8* p = m_hmtx + 4 * entry;
+    return readU16(p, m_hmtx + m_hmtxLength);
+}
+
+int TrueTypeFont::leftSideBearing(U32 index) const
+{
+    const U8* p = index < m_hMetricCount
+                ? m_hmtx + 4 * index + 2
+                : m_hmtx + 4 * m_hMetricCount + 2 * (index - m_hMetricCount);
+    return readS16(p, m_hmtx + m_hmtxLength);
+}
+
+void TrueTypeFont::loadMetrics(U32 index, Glyph::GlyphInfo& metrics) const
+{
+    Metrics glyph{advance(index), 0};
+    ivec2 boxMin{0, 0}, boxMax{0, 0};
+    loadHeader(index, glyph, boxMin, boxMax, 0);
+    metrics.width = boxMax.x - boxMin.x;
+    metrics.height = boxMax.y - boxMin.y;
+    metrics.hCursorX = boxMin.x - glyph.originShift;
+    metrics.hCursorY = boxMax.y;
+    metrics.xAdvance = glyph.advance;
+    // The fonts carry no vertical metrics we read, so synthesise them like
+    // FreeType does.
+    metrics.yAdvance = m_verticalAdvance;
+    metrics.vCursorX = metrics.hCursorX - metrics.xAdvance / 2;
+    metrics.vCursorY = (metrics.yAdvance - metrics.height) / 2;
+}
+
+const U8* TrueTypeFont::glyphData(U32 index, const U8*& end) const
+{
+    if (index >= m_glyphCount)
+    {
+        throw std::runtime_error("Glyph index out of range.");
+    }
+    const U8* locaEnd = m_loca + m_locaLength;
+    const U8* p;
+    U32 offset, next;
+    if (m_longLoca)
+    {
+        p = m_loca + 4 * index;
+        offset = readU32(p, locaEnd);
+        next = readU32(p, locaEnd);
+    }
+    else
+    {
+        p = m_loca + 2 * index;
+        offset = 2 * (U32)readU16(p, locaEnd);
+        next = 2 * (U32)readU16(p, locaEnd);
+    }
+    if (next <= offset) return nullptr;
+    if (next > m_glyfLength)
+    {
+        throw std::runtime_error("Glyph data out of range.");
+    }
+    end = m_glyf + next;
+    return m_glyf + offset;
+}
+
+void TrueTypeFont::loadHeader(U32 index, Metrics& glyph, ivec2& boxMin,
+                              ivec2& boxMax, int depth) const
+{
+    if (depth > maxCompositeDepth)
+    {
+        throw std::runtime_error("Composite glyph nested too deeply.");
+    }
+    const U8* end;
+    const U8* p = glyphData(index, end);
+    if (!p) return;
+
+    S16 contourCount = readS16(p, end);
+    boxMin.x = readS16(p, end);
+    boxMin.y = readS16(p, end);
+    boxMax.x = readS16(p, end);
+    boxMax.y = readS16(p, end);
+    glyph.originShift = boxMin.x - leftSideBearing(index);
+    if (contourCount >= 0) return;
+
+    // Only a component with useMyMetrics matters here; the others are
+    // skipped without looking at their data.
+    U16 flags;
+    do
+    {
+        flags = readU16(p, end);
+        U16 component = readU16(p, end);
+        size_t skip = (flags & argsAreWords) ? 4 : 2;
+        if (flags & haveScale) skip += 2;
+        else if (flags & haveXYScale) skip += 4;
+        else if (flags & haveTwoByTwo) skip += 8;
+        need(p, skip, end);
+        p += skip;
+        if (flags & useMyMetrics)
+        {
+            Metrics part{advance(component), 0};
+            ivec2 partMin{0, 0}, partMax{0, 0};
+            loadHeader(component, part, partMin, partMax, depth + 1);
+            glyph = part;
+        }
+    } while (flags & moreComponents);
+}
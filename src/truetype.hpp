@@ -0,0 +1,65 @@
+#ifndef TRUETYPE_HPP_INCLUDED
+#define TRUETYPE_HPP_INCLUDED
+
+#include "glyph.hpp"
+#include "types.hpp"
+#include "vector2.hpp"
+
+// Minimal reader for the metrics of TrueType ('glyf') fonts directly from font
+// data in memory, typically a MappedFile, without FreeType loading any glyph.
+// Only the horizontal metrics and the glyph headers are read; outlines are
+// left to FreeType. The data is not copied and must outlive the reader.
+class TrueTypeFont
+{
+public:
+    TrueTypeFont(const U8* data, size_t size);
+
+    size_t glyphCount() const { return m_glyphCount; }
+    int emSize() const { return m_emSize; }
+
+    // Metrics of glyph 'index' in font units, from its header and 'hmtx'.
+    // Advances match those FreeType reports with FT_LOAD_NO_SCALE; the
+    // bounding box is the one the font declares, which can be a few units
+    // larger than that of the points where the font was not built with tight
+    // boxes. Vertical metrics are synthesised as FreeType does.
+    void loadMetrics(U32 index, Glyph::GlyphInfo& metrics) const;
+
+private:
+    struct Metrics
+    {
+        int advance;
+        // Difference between the header's xMin and the left side bearing;
+        // the box is shifted left by this to put the origin where the
+        // horizontal metrics say it is.
+        int originShift;
+    };
+
+    // Null if the font has no such table.
+    const U8* findTable(const char* tag, size_t& length) const;
+    const U8* table(const char* tag, size_t& length) const;
+    // Start and end of the data of glyph 'index'; null if it is empty.
+    const U8* glyphData(U32 index, const U8*& end) const;
+    // Reads the header of glyph 'index' and the metrics its composite
+    // components pass on.
+    void loadHeader(U32 index, Metrics& glyph, ivec2& boxMin, ivec2& boxMax,
+                    int depth) const;
+    int advance(U32 index) const;
+    int leftSideBearing(U32 index) const;
+
+    const U8* m_data;
+    size_t m_size;
+
+    const U8* m_glyf;
+    size_t m_glyfLength;
+    const U8* m_loca;
+    size_t m_locaLength;
+    const U8* m_hmtx;
+    size_t m_hmtxLength;
+    bool m_longLoca;
+    size_t m_glyphCount;
+    size_t m_hMetricCount;
+    int m_emSize;
+    int m_verticalAdvance;
+};
+
+#endif // TRUETYPE_HPP_INCLUDED